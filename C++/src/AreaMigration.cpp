@@ -0,0 +1,227 @@
+#include "AreaMigration.h"
+
+#include <unordered_set>
+
+using namespace std;
+using namespace util;
+using namespace game_server;
+using namespace game_server::objects;
+
+const uint8 area_migrator::migrate_method;
+const uint8 area_migrator::redirect_method;
+const uint8 area_migrator::acknowledge_method;
+
+area_migrator::area_migrator(processor_node& node, cache_provider& cache, obj_id area_id, object_writer writer, object_reader reader) : node(node), cache(cache), writer(writer), reader(reader) {
+	this->area_id = area_id;
+	this->next_transfer = 0;
+
+	this->node.set_control_handler(area_migrator::migrate_method, bind(&area_migrator::on_migrate, this, placeholders::_1));
+	this->node.set_control_handler(area_migrator::acknowledge_method, bind(&area_migrator::on_acknowledge, this, placeholders::_1));
+}
+
+void area_migrator::cede(obj_id target_area, coord x, coord y, dimension width, dimension height, coord new_x, coord new_y, dimension new_width, dimension new_height) {
+	auto message = this->node.create_message(0x00, area_migrator::migrate_method);
+	vector<unique_ptr<map_obj>> released;
+	uint32 transfer_id;
+
+	{
+		unique_lock<cache_provider> lck(this->cache);
+
+		released = this->cache.release_area(x, y, width, height);
+		this->cache.resize(new_x, new_y, new_width, new_height);
+	}
+
+	{
+		unique_lock<mutex> lck(this->pending_lock);
+
+		transfer_id = this->next_transfer++;
+	}
+
+	message.write(this->area_id);
+	message.write(transfer_id);
+	message.write(x);
+	message.write(y);
+	message.write(width);
+	message.write(height);
+	message.write(static_cast<uint32>(released.size()));
+
+	for (auto& i : released)
+		this->writer(*i, message);
+
+	{
+		unique_lock<mutex> lck(this->pending_lock);
+
+		this->pending[transfer_id] = transfer { target_area, chrono::steady_clock::now(), move(released) };
+	}
+
+	try {
+		this->node.send_to_broker(target_area, move(message));
+	}
+	catch (...) {
+		transfer failed;
+
+		{
+			unique_lock<mutex> lck(this->pending_lock);
+
+			failed = move(this->pending[transfer_id]);
+			this->pending.erase(transfer_id);
+		}
+
+		auto leftover = this->restore(move(failed.objects));
+
+		if (!leftover.empty()) {
+			unique_lock<mutex> lck(this->pending_lock);
+
+			this->pending[transfer_id] = transfer { target_area, failed.sent, move(leftover) };
+		}
+
+		throw;
+	}
+}
+
+vector<unique_ptr<map_obj>> area_migrator::restore(vector<unique_ptr<map_obj>> objects) {
+	vector<unique_ptr<map_obj>> leftover;
+	unique_lock<cache_provider> lck(this->cache);
+
+	for (auto& i : objects) {
+		this->cache.extend_bounds(i->x, i->y, i->width, i->height);
+
+		if (this->cache.is_area_empty(i->x, i->y, i->width, i->height))
+			this->cache.adopt(move(i));
+		else
+			leftover.push_back(move(i));
+	}
+
+	return leftover;
+}
+
+void area_migrator::reclaim(chrono::milliseconds older_than) {
+	auto cutoff = chrono::steady_clock::now() - older_than;
+	vector<pair<uint32, transfer>> expired;
+
+	{
+		unique_lock<mutex> lck(this->pending_lock);
+
+		for (auto iter = this->pending.begin(); iter != this->pending.end(); ) {
+			if (iter->second.sent <= cutoff) {
+				expired.emplace_back(iter->first, move(iter->second));
+				iter = this->pending.erase(iter);
+			}
+			else {
+				iter++;
+			}
+		}
+	}
+
+	for (auto& i : expired) {
+		auto leftover = this->restore(move(i.second.objects));
+
+		if (!leftover.empty()) {
+			unique_lock<mutex> lck(this->pending_lock);
+
+			this->pending[i.first] = transfer { i.second.target_area, i.second.sent, move(leftover) };
+		}
+	}
+}
+
+word area_migrator::get_pending_count() {
+	unique_lock<mutex> lck(this->pending_lock);
+
+	return this->pending.size();
+}
+
+void area_migrator::on_migrate(data_stream& message) {
+	auto source_area = message.read<obj_id>();
+	auto transfer_id = message.read<uint32>();
+	auto x = message.read<coord>();
+	auto y = message.read<coord>();
+	auto width = message.read<dimension>();
+	auto height = message.read<dimension>();
+	auto count = message.read<uint32>();
+	vector<unique_ptr<map_obj>> incoming;
+	vector<obj_id> accepted;
+	bool parsed = true;
+
+	try {
+		for (uint32 i = 0; i < count; i++)
+			incoming.push_back(this->reader(message));
+	}
+	catch (data_stream::read_past_end_exception&) {
+		incoming.clear();
+		parsed = false;
+	}
+
+	if (parsed) {
+		unique_lock<cache_provider> lck(this->cache);
+
+		this->cache.extend_bounds(x, y, width, height);
+
+		for (auto& i : incoming) {
+			auto id = i->id;
+
+			this->cache.remove_halo(id);
+
+			if (!this->cache.is_area_empty(i->x, i->y, i->width, i->height))
+				continue;
+
+			this->cache.adopt(move(i));
+			accepted.push_back(id);
+		}
+	}
+
+	auto acknowledgement = this->node.create_message(0x00, area_migrator::acknowledge_method);
+
+	acknowledgement.write(this->area_id);
+	acknowledgement.write(transfer_id);
+	acknowledgement.write(static_cast<uint32>(accepted.size()));
+
+	for (auto i : accepted)
+		acknowledgement.write(i);
+
+	this->node.send_to_broker(source_area, move(acknowledgement));
+}
+
+void area_migrator::on_acknowledge(data_stream& message) {
+	auto target_area = message.read<obj_id>();
+	auto transfer_id = message.read<uint32>();
+	auto count = message.read<uint32>();
+	unordered_set<obj_id> accepted;
+	unordered_set<owner_id> owners;
+	vector<unique_ptr<map_obj>> rejected;
+	transfer acknowledged;
+
+	for (uint32 i = 0; i < count; i++)
+		accepted.insert(message.read<obj_id>());
+
+	{
+		unique_lock<mutex> lck(this->pending_lock);
+
+		auto iter = this->pending.find(transfer_id);
+		if (iter == this->pending.end() || iter->second.target_area != target_area)
+			return;
+
+		acknowledged = move(iter->second);
+		this->pending.erase(iter);
+	}
+
+	for (auto& i : acknowledged.objects) {
+		if (accepted.count(i->id) == 0)
+			rejected.push_back(move(i));
+		else if (i->owner != 0)
+			owners.insert(i->owner);
+	}
+
+	auto leftover = this->restore(move(rejected));
+
+	if (!leftover.empty()) {
+		unique_lock<mutex> lck(this->pending_lock);
+
+		this->pending[transfer_id] = transfer { target_area, acknowledged.sent, move(leftover) };
+	}
+
+	for (auto i : owners) {
+		auto redirect = this->node.create_message(0x00, area_migrator::redirect_method);
+		redirect.write(target_area);
+		this->node.send(i, move(redirect));
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+#include <ArkeIndustries.CPPUtilities/DataStream.h>
+
+#include "Common.h"
+#include "Objects.h"
+#include "CacheProvider.h"
+#include "ProcessorNode.h"
+
+namespace game_server {
+	class area_migrator {
+		public:
+			typedef std::function<void(const objects::map_obj&, util::data_stream&)> object_writer;
+			typedef std::function<std::unique_ptr<objects::map_obj>(util::data_stream&)> object_reader;
+
+			static const uint8 migrate_method = 0x02;
+			static const uint8 redirect_method = 0x03;
+			static const uint8 acknowledge_method = 0x05;
+
+		private:
+			struct transfer {
+				obj_id target_area;
+				std::chrono::steady_clock::time_point sent;
+				std::vector<std::unique_ptr<objects::map_obj>> objects;
+			};
+
+			processor_node& node;
+			cache_provider& cache;
+			object_writer writer;
+			object_reader reader;
+			obj_id area_id;
+
+			std::unordered_map<uint32, transfer> pending;
+			std::mutex pending_lock;
+			uint32 next_transfer;
+
+			std::vector<std::unique_ptr<objects::map_obj>> restore(std::vector<std::unique_ptr<objects::map_obj>> objects);
+			void on_migrate(util::data_stream& message);
+			void on_acknowledge(util::data_stream& message);
+
+		public:
+			area_migrator(const area_migrator& other) = delete;
+			area_migrator(area_migrator&& other) = delete;
+			area_migrator& operator=(area_migrator&& other) = delete;
+			area_migrator& operator=(const area_migrator& other) = delete;
+
+			area_migrator(processor_node& node, cache_provider& cache, obj_id area_id, object_writer writer, object_reader reader);
+			~area_migrator() = default;
+
+			void cede(obj_id target_area, coord x, coord y, dimension width, dimension height, coord new_x, coord new_y, dimension new_width, dimension new_height);
+			void reclaim(std::chrono::milliseconds older_than);
+			word get_pending_count();
+	};
+}
@@ -1,5 +1,8 @@
 #include "BrokerNode.h"
 
+#include <functional>
+#include <chrono>
+
 #include <ArkeIndustries.CPPUtilities/Common.h>
 
 #include "Common.h"
@@ -9,29 +12,386 @@ using namespace util;
 using namespace util::net;
 using namespace game_server;
 
-broker_node::broker_node(word workers, endpoint ep) : processor_node(workers, ep) {
+broker_node::broker_node(word workers, endpoint ep, word batch_size, chrono::microseconds batch_delay) : processor_node(workers, ep) {
+	this->routes = make_shared<const route_table>();
+	this->batch_size = batch_size;
+	this->header_size = this->create_message(0x00, 0x00).size();
+	this->self_index = 0;
+	this->running = true;
+
+	if (this->batch_size > 1) {
+		this->flush_timer.reset(new timer<>(batch_delay));
+		this->flush_timer->on_tick += bind(&broker_node::flush_all, this);
+	}
+}
+
+broker_node::~broker_node() {
+	this->running = false;
+
+	if (this->local_poller.joinable())
+		this->local_poller.join();
+}
+
+void broker_node::set_peers(vector<endpoint> peers, word self_index) {
+	unique_lock<mutex> lck(this->peers_lock);
+
+	this->peer_eps = peers;
+	this->self_index = self_index;
+	this->peers.assign(peers.size(), nullptr);
+	this->peer_attempts.assign(peers.size(), 0);
+	this->peer_ring.reset(peers.size());
+}
+
+void broker_node::start() {
+	processor_node::start();
+
+	if (this->peer_eps.size() > 1) {
+		this->dial_peers();
+		this->peer_timer.reset(new timer<>(chrono::duration_cast<chrono::microseconds>(this->broker_connect_backoff)));
+		this->peer_timer->on_tick += bind(&broker_node::dial_peers, this);
+	}
+}
+
+void broker_node::dial_peers() {
+	for (word i = 0; i < this->peer_eps.size(); i++) {
+		{
+			unique_lock<mutex> lck(this->peers_lock);
+
+			if (i == this->self_index || this->peers[i])
+				continue;
+		}
+
+		shared_ptr<tcp_connection> connection;
+
+		try {
+			connection = this->server.adopt(tcp_connection(this->peer_eps[i]));
+		}
+		catch (...) {
+
+		}
+
+		unique_lock<mutex> lck(this->peers_lock);
+
+		if (connection) {
+			this->peers[i] = connection;
+			this->peer_attempts[i] = 0;
+			this->peer_ring.add(i);
+		}
+		else if (++this->peer_attempts[i] >= this->broker_connect_attempts) {
+			this->peer_ring.remove(i);
+		}
+	}
+}
+
+bool broker_node::drop_peer(shared_ptr<tcp_connection> connection) {
+	unique_lock<mutex> lck(this->peers_lock);
+
+	for (word i = 0; i < this->peers.size(); i++) {
+		if (this->peers[i] == connection) {
+			this->peers[i] = nullptr;
+			this->peer_ring.remove(i);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void broker_node::add_route(obj_id area, shared_ptr<tcp_connection> connection) {
+	unique_lock<mutex> lck(this->routes_lock);
+
+	auto table = make_shared<route_table>(*atomic_load(&this->routes));
+	auto batch = make_shared<pending_batch>();
+
+	batch->frame = this->create_message(0x00, processor_node::broker_batch_method);
+	batch->count = 0;
+	batch->retired = false;
+
+	auto existing = table->find(area);
+	auto replaced = existing != table->end() ? existing->second : route();
+
+	(*table)[area] = route { connection, batch };
+
+	atomic_store(&this->routes, shared_ptr<const route_table>(table));
+
+	if (replaced.batch)
+		this->retire(replaced);
+}
+
+void broker_node::remove_route(shared_ptr<tcp_connection> connection) {
+	unique_lock<mutex> lck(this->routes_lock);
+
+	auto table = make_shared<route_table>(*atomic_load(&this->routes));
+	vector<route> removed;
+
+	for (auto i = table->begin(); i != table->end(); ) {
+		if (i->second.connection == connection) {
+			removed.push_back(i->second);
+			i = table->erase(i);
+		}
+		else {
+			++i;
+		}
+	}
+
+	atomic_store(&this->routes, shared_ptr<const route_table>(table));
+
+	for (auto& i : removed)
+		this->retire(i);
+}
+
+void broker_node::forward(const route& destination, uint8 category, uint8 method, data_stream& message, word body_start, word body_end, bool last, bool batchable) {
+	if (this->batch_size <= 1 || !batchable) {
+		if (last) {
+			message.shrink_written(body_end);
+			this->server.enqueue_outgoing(request_server::message(destination.connection, move(message)));
+		}
+		else {
+			data_stream copy(message);
+			copy.shrink_written(body_end);
+			this->server.enqueue_outgoing(request_server::message(destination.connection, move(copy)));
+		}
+
+		return;
+	}
+
+	auto& batch = *destination.batch;
+	unique_lock<mutex> lck(batch.lock);
+
+	if (batch.retired) {
+		lck.unlock();
+		this->forward(destination, category, method, message, body_start, body_end, last, false);
+		return;
+	}
+
+	batch.frame.write(category);
+	batch.frame.write(method);
+	batch.frame.write(static_cast<uint32>(body_end - body_start));
+	batch.frame.write(message.data() + body_start, body_end - body_start);
+
+	if (++batch.count >= this->batch_size) {
+		lck.unlock();
+		this->flush(destination);
+	}
+}
+
+void broker_node::flush(const route& destination) {
+	auto& batch = *destination.batch;
+	data_stream frame = this->create_message(0x00, processor_node::broker_batch_method);
+
+	{
+		unique_lock<mutex> lck(batch.lock);
+
+		if (batch.count == 0)
+			return;
+
+		swap(frame, batch.frame);
+		batch.count = 0;
+	}
+
+	this->server.enqueue_outgoing(request_server::message(destination.connection, move(frame)));
+}
+
+void broker_node::retire(const route& destination) {
+	{
+		unique_lock<mutex> lck(destination.batch->lock);
+
+		destination.batch->retired = true;
+	}
+
+	this->flush(destination);
+}
+
+void broker_node::flush_all() {
+	auto table = atomic_load(&this->routes);
+
+	for (auto& i : *table)
+		this->flush(i.second);
+}
+
+void broker_node::forward_to_peer(obj_id target, data_stream& message, word body_end) {
+	shared_ptr<tcp_connection> peer;
+
+	{
+		unique_lock<mutex> lck(this->peers_lock);
+
+		if (this->peers.empty() || this->peer_ring.size() == 0)
+			return;
+
+		auto owner = this->peer_ring.owner(target);
+		if (owner == this->self_index)
+			return;
+
+		peer = this->peers[owner];
+	}
+
+	if (!peer)
+		return;
+
+	data_stream copy(message);
+	copy.shrink_written(body_end);
+	copy.write(target);
+	this->server.enqueue_outgoing(request_server::message(peer, move(copy)));
+}
+
+void broker_node::attach_local(shared_ptr<tcp_connection> connection, data_stream& parameters, word body_start, word body_end) {
+	if (body_end <= body_start)
+		return;
+
+	parameters.seek(body_start);
 
+	auto length = parameters.read<uint16>();
+	if (body_end - parameters.position() < length)
+		return;
+
+	string name(reinterpret_cast<const char*>(parameters.data() + parameters.position()), length);
+
+	auto channel = local_channel::open(name);
+	if (!channel)
+		return;
+
+	channel->set_attached();
+
+	unique_lock<mutex> lck(this->local_links_lock);
+	this->local_links.push_back(local_link { connection, shared_ptr<local_channel>(move(channel)) });
+
+	if (!this->local_poller.joinable())
+		this->local_poller = thread(&broker_node::poll_local, this);
+}
+
+void broker_node::poll_local() {
+	vector<local_link> links;
+	vector<uint8> frame;
+
+	while (this->running) {
+		bool idle = true;
+
+		{
+			unique_lock<mutex> lck(this->local_links_lock);
+			links = this->local_links;
+		}
+
+		for (auto& i : links) {
+			while (i.channel->read(frame)) {
+				if (this->header_size < 2 || frame.size() < this->header_size + sizeof(obj_id))
+					continue;
+
+				data_stream message;
+
+				message.write(frame.data(), frame.size());
+				message.seek(0);
+
+				this->relay(i.connection, frame[this->header_size - 2], frame[this->header_size - 1], message, this->header_size, message.size() - sizeof(obj_id), true);
+
+				idle = false;
+			}
+		}
+
+		if (idle)
+			this_thread::sleep_for(links.empty() ? chrono::microseconds(1000) : chrono::microseconds(50));
+	}
 }
 
 void broker_node::on_disconnect(shared_ptr<tcp_connection> client) {
-	auto id = reinterpret_cast<obj_id>(client->state);
-	if (this->authenticated_clients.count(id) != 0)
-		this->authenticated_clients.erase(id);
+	if (this->drop_peer(client))
+		return;
+
+	auto id = this->get_client_id(client.get());
+
+	this->remove_route(client);
+
+	{
+		unique_lock<mutex> lck(this->local_links_lock);
+
+		for (auto i = this->local_links.begin(); i != this->local_links.end(); ) {
+			if (i->connection == client)
+				i = this->local_links.erase(i);
+			else
+				++i;
+		}
+	}
+
+	{
+		unique_lock<mutex> lck(this->clients_lock);
+
+		if (this->authenticated_clients.count(id) != 0)
+			this->authenticated_clients.erase(id);
+	}
+
 	processor_node::on_disconnect(client);
 }
 
 request_server::request_result broker_node::on_request(shared_ptr<tcp_connection> client, word worker_number, uint8 category, uint8 method, data_stream& parameters, data_stream& response) {
-	parameters.seek(parameters.size() - sizeof(obj_id));
+	this->pin_worker(worker_number);
+
+	word body_start = parameters.position();
+
+	if (parameters.size() < body_start + sizeof(obj_id))
+		return request_server::request_result::no_response;
+
+	word body_end = parameters.size() - sizeof(obj_id);
+
+	if (category == 0x00 && (method == 0x00 || method == processor_node::broker_attach_method)) {
+		parameters.seek(body_end);
+		obj_id client_area_id = parameters.read<obj_id>();
+
+		{
+			unique_lock<mutex> lck(this->clients_lock);
+
+			if (!client->state) {
+				client->state = reinterpret_cast<void*>(client_area_id);
+				this->authenticated_clients[client_area_id].push_back(client);
+			}
+		}
+
+		if (method == 0x00)
+			this->add_route(client_area_id, client);
+
+		this->attach_local(client, parameters, body_start, body_end);
+
+		return request_server::request_result::no_response;
+	}
+
+	this->relay(client, category, method, parameters, body_start, body_end, true);
+
+	return request_server::request_result::no_response;
+}
+
+void broker_node::relay(shared_ptr<tcp_connection> client, uint8 category, uint8 method, data_stream& parameters, word body_start, word body_end, bool batchable) {
+	parameters.seek(body_end);
 	obj_id client_area_id = parameters.read<obj_id>();
 
-	if (category == 0x00 && method == 0x00) {
-		client->state = reinterpret_cast<void*>(client_area_id);
-		this->authenticated_clients[client_area_id].push_back(client);
+	auto table = atomic_load(&this->routes);
+	auto from_processor = this->get_client_id(client.get()) != 0;
+
+	if (client_area_id != 0) {
+		auto iter = table->find(client_area_id);
+		if (iter != table->end())
+			this->forward(iter->second, category, method, parameters, body_start, body_end, true, batchable);
+		else if (from_processor)
+			this->forward_to_peer(client_area_id, parameters, body_end);
 	}
 	else {
-		parameters.shrink_written(parameters.size() - sizeof(obj_id));
-		this->send(client_area_id, move(parameters));
-	}
+		if (body_end - body_start < sizeof(uint16))
+			return;
 
-	return request_server::request_result::no_response;
-}
\ No newline at end of file
+		parameters.seek(body_end - sizeof(uint16));
+		auto count = parameters.read<uint16>();
+
+		if (body_end - body_start < sizeof(uint16) + count * sizeof(obj_id))
+			return;
+
+		body_end -= sizeof(uint16) + count * sizeof(obj_id);
+		parameters.seek(body_end);
+
+		for (uint16 i = 0; i < count; i++) {
+			auto target = parameters.read<obj_id>();
+			auto iter = table->find(target);
+			if (iter != table->end())
+				this->forward(iter->second, category, method, parameters, body_start, body_end, i == count - 1, batchable);
+			else if (from_processor)
+				this->forward_to_peer(target, parameters, body_end);
+		}
+	}
+}
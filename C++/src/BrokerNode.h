@@ -1,14 +1,75 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <atomic>
 
 #include <ArkeIndustries.CPPUtilities/DataStream.h>
+#include <ArkeIndustries.CPPUtilities/Timer.h>
 #include <ArkeIndustries.CPPUtilities/Net/TCPConnection.h>
 
 #include "ProcessorNode.h"
+#include "HashRing.h"
+#include "LocalChannel.h"
 
 namespace game_server {
 	class broker_node : public processor_node {
+		struct pending_batch {
+			std::mutex lock;
+			util::data_stream frame;
+			word count;
+			bool retired;
+		};
+
+		struct route {
+			std::shared_ptr<util::net::tcp_connection> connection;
+			std::shared_ptr<pending_batch> batch;
+		};
+
+		typedef std::unordered_map<obj_id, route> route_table;
+
+		std::shared_ptr<const route_table> routes;
+		std::mutex routes_lock;
+		word batch_size;
+		word header_size;
+		std::unique_ptr<util::timer<>> flush_timer;
+
+		std::vector<util::net::endpoint> peer_eps;
+		std::vector<std::shared_ptr<util::net::tcp_connection>> peers;
+		std::vector<word> peer_attempts;
+		hash_ring peer_ring;
+		std::mutex peers_lock;
+		word self_index;
+		std::unique_ptr<util::timer<>> peer_timer;
+
+		struct local_link {
+			std::shared_ptr<util::net::tcp_connection> connection;
+			std::shared_ptr<local_channel> channel;
+		};
+
+		std::vector<local_link> local_links;
+		std::mutex local_links_lock;
+		std::thread local_poller;
+		std::atomic<bool> running;
+
+		void attach_local(std::shared_ptr<util::net::tcp_connection> connection, util::data_stream& parameters, word body_start, word body_end);
+		void poll_local();
+		void relay(std::shared_ptr<util::net::tcp_connection> client, uint8 category, uint8 method, util::data_stream& parameters, word body_start, word body_end, bool batchable);
+
+		void add_route(obj_id area, std::shared_ptr<util::net::tcp_connection> connection);
+		void remove_route(std::shared_ptr<util::net::tcp_connection> connection);
+		void forward(const route& destination, uint8 category, uint8 method, util::data_stream& message, word body_start, word body_end, bool last, bool batchable);
+		void flush(const route& destination);
+		void retire(const route& destination);
+		void flush_all();
+		void forward_to_peer(obj_id target, util::data_stream& message, word body_end);
+		void dial_peers();
+		bool drop_peer(std::shared_ptr<util::net::tcp_connection> connection);
+
 		virtual void on_disconnect(std::shared_ptr<util::net::tcp_connection> client) override;
 		virtual util::net::request_server::request_result on_request(std::shared_ptr<util::net::tcp_connection> client, word worker_number, uint8 category, uint8 method, util::data_stream& parameters, util::data_stream& response) override;
 	
@@ -18,7 +79,10 @@ namespace game_server {
 			broker_node& operator=(broker_node&& other) = delete;
 			broker_node& operator=(const broker_node& other) = delete;
 	
-			broker_node(word workers, util::net::endpoint ep);
-			virtual ~broker_node() = default;
+			broker_node(word workers, util::net::endpoint ep, word batch_size = 0, std::chrono::microseconds batch_delay = std::chrono::microseconds(250));
+			virtual ~broker_node();
+
+			void set_peers(std::vector<util::net::endpoint> peers, word self_index);
+			virtual void start() override;
 	};
 }
@@ -0,0 +1,248 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+
+#include "Common.h"
+#include "Objects.h"
+#include "CacheProvider.h"
+#include "Updater.h"
+
+using namespace std;
+using namespace util;
+using namespace game_server;
+using namespace game_server::objects;
+
+struct bench_obj : public map_obj, public updatable {
+	bench_obj() : map_obj(1) {
+
+	}
+
+	virtual bench_obj* clone() const override {
+		return new bench_obj(*this);
+	}
+
+	virtual void update(uint64 delta) override {
+		this->value += delta;
+	}
+
+	uint64 value = 0;
+};
+
+struct bench_config {
+	dimension map_size = 1024;
+	double density = 0.05;
+	dimension max_footprint = 3;
+	dimension los_radius = 10;
+	word owners = 256;
+	double clustering = 0.8;
+	word operations = 100000;
+	word max_threads = 8;
+	word updates_per_tick = 1000;
+	bool compact = false;
+};
+
+struct bench_world {
+	bench_world() : next_id(1) {
+
+	}
+
+	vector<obj_id> ids;
+	vector<owner_id> owners;
+	atomic<obj_id> next_id;
+};
+
+static void report(const string& name, word threads, word operations, chrono::nanoseconds elapsed) {
+	cout << "{\"benchmark\":\"" << name << "\",\"threads\":" << threads << ",\"operations\":" << operations << ",\"total_ns\":" << elapsed.count() << ",\"ns_per_op\":" << (operations ? elapsed.count() / static_cast<int64>(operations) : 0) << "}" << endl;
+}
+
+static void run_threads(const string& name, word threads, word operations, function<void(mt19937_64&)> operation) {
+	vector<thread> workers;
+	word per_thread = operations / threads;
+
+	auto start = chrono::steady_clock::now();
+
+	for (word i = 0; i < threads; i++) {
+		workers.emplace_back([&operation, per_thread, i] {
+			mt19937_64 generator(i + 1);
+
+			for (word j = 0; j < per_thread; j++)
+				operation(generator);
+		});
+	}
+
+	for (auto& i : workers)
+		i.join();
+
+	report(name, threads, per_thread * threads, chrono::steady_clock::now() - start);
+}
+
+static owner_id pick_owner(const bench_config& config, coord x, coord y, mt19937_64& generator) {
+	uniform_real_distribution<double> chance(0.0, 1.0);
+	word clusters_per_side = max<word>(1, static_cast<word>(sqrt(static_cast<double>(config.owners))));
+	word cluster_size = max<word>(1, config.map_size / clusters_per_side);
+
+	if (chance(generator) < config.clustering)
+		return 1 + ((x / cluster_size) * clusters_per_side + (y / cluster_size)) % config.owners;
+
+	return 1 + generator() % config.owners;
+}
+
+static void populate(cache_provider& cache, bench_world& world, const bench_config& config) {
+	mt19937_64 generator(0);
+	uniform_int_distribution<coord> position(0, config.map_size - 1);
+	uniform_int_distribution<dimension> footprint(1, config.max_footprint);
+	word target = static_cast<word>(static_cast<double>(config.map_size) * config.map_size * config.density);
+
+	cache.begin_update();
+
+	for (word attempts = 0; world.ids.size() < target && attempts < target * 4; attempts++) {
+		bench_obj object;
+
+		object.id = world.next_id;
+		object.width = footprint(generator);
+		object.height = footprint(generator);
+		object.x = min<coord>(position(generator), config.map_size - object.width);
+		object.y = min<coord>(position(generator), config.map_size - object.height);
+		object.owner = pick_owner(config, object.x, object.y, generator);
+
+		if (!cache.is_area_empty(object.x, object.y, object.width, object.height))
+			continue;
+
+		try {
+			cache.add(object);
+		}
+		catch (const sql::synchronization_exception&) {
+			continue;
+		}
+
+		world.ids.push_back(object.id);
+		world.owners.push_back(object.owner);
+		world.next_id++;
+	}
+
+	cache.end_update();
+}
+
+static bool parse(bench_config& config, const string& argument) {
+	auto split = argument.find('=');
+	if (argument.compare(0, 2, "--") != 0 || split == string::npos)
+		return false;
+
+	auto key = argument.substr(2, split - 2);
+	auto value = argument.substr(split + 1);
+
+	if (key == "map-size") config.map_size = stoul(value);
+	else if (key == "density") config.density = stod(value);
+	else if (key == "max-footprint") config.max_footprint = stoul(value);
+	else if (key == "los-radius") config.los_radius = stoul(value);
+	else if (key == "owners") config.owners = stoul(value);
+	else if (key == "clustering") config.clustering = stod(value);
+	else if (key == "operations") config.operations = stoul(value);
+	else if (key == "max-threads") config.max_threads = stoul(value);
+	else if (key == "updates-per-tick") config.updates_per_tick = stoul(value);
+	else if (key == "compact") config.compact = stoul(value) != 0;
+	else return false;
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+	bench_config config;
+
+	for (int i = 1; i < argc; i++) {
+		if (!parse(config, argv[i])) {
+			cerr << "usage: " << argv[0] << " [--map-size=N] [--density=F] [--max-footprint=N] [--los-radius=N] [--owners=N] [--clustering=F] [--operations=N] [--max-threads=N] [--updates-per-tick=N] [--compact=0|1]" << endl;
+			return 1;
+		}
+	}
+
+	cache_provider cache(0, 0, config.map_size, config.map_size, config.los_radius);
+	bench_world world;
+
+	cache.set_compact_mode(config.compact);
+
+	auto populate_start = chrono::steady_clock::now();
+	populate(cache, world, config);
+	report("populate", 1, world.ids.size(), chrono::steady_clock::now() - populate_start);
+
+	auto memory = cache.get_memory_usage();
+	cout << "{\"memory\":{\"compact\":" << config.compact << ",\"objects\":" << memory.object_count << ",\"updatable_idx\":" << memory.updatable_idx << ",\"id_idx\":" << memory.id_idx << ",\"owner_idx\":" << memory.owner_idx << ",\"loc_idx\":" << memory.loc_idx << ",\"halo_idx\":" << memory.halo_idx << ",\"object_table\":" << memory.object_table << "}}" << endl;
+
+	if (world.ids.empty())
+		return 0;
+
+	auto position = [&config](mt19937_64& generator) { return static_cast<coord>(generator() % config.map_size); };
+
+	cache_updater updater(cache, config.updates_per_tick, chrono::microseconds(1000000000));
+
+	for (word threads = 1; threads <= config.max_threads; threads *= 2) {
+		run_threads("get_in_area", threads, config.operations, [&](mt19937_64& generator) {
+			cache.get_in_area(position(generator), position(generator), config.los_radius * 2, config.los_radius * 2);
+		});
+
+		run_threads("get_in_owner_los", threads, config.operations / 10, [&](mt19937_64& generator) {
+			cache.get_in_owner_los(world.owners[generator() % world.owners.size()]);
+		});
+
+		run_threads("is_location_in_los", threads, config.operations, [&](mt19937_64& generator) {
+			cache.is_location_in_los(position(generator), position(generator), world.owners[generator() % world.owners.size()]);
+		});
+
+		run_threads("get_users_with_los_at", threads, config.operations, [&](mt19937_64& generator) {
+			cache.get_users_with_los_at(position(generator), position(generator));
+		});
+
+		run_threads("update_churn", threads, config.operations / 10, [&](mt19937_64& generator) {
+			auto object = cache.get_by_id<bench_obj>(world.ids[generator() % world.ids.size()]);
+			if (object.id == 0)
+				return;
+
+			object.x = min<coord>(position(generator), config.map_size - object.width);
+			object.y = min<coord>(position(generator), config.map_size - object.height);
+
+			try {
+				cache.update_single(object);
+			}
+			catch (const sql::synchronization_exception&) {
+
+			}
+		});
+
+		run_threads("add_remove_churn", threads, config.operations / 10, [&](mt19937_64& generator) {
+			bench_obj object;
+
+			object.id = world.next_id++;
+			object.x = position(generator);
+			object.y = position(generator);
+			object.owner = pick_owner(config, object.x, object.y, generator);
+
+			cache.begin_update();
+
+			try {
+				cache.add(object);
+				cache.remove(object);
+			}
+			catch (const sql::synchronization_exception&) {
+
+			}
+
+			cache.end_update();
+		});
+
+		run_threads("cache_updater_tick", threads, config.operations / 100, [&](mt19937_64& generator) {
+			updater.tick();
+		});
+	}
+
+	return 0;
+}
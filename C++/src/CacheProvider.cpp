@@ -23,19 +23,304 @@ void cache_provider::set_bounds(coord start_x, coord start_y, dimension width, d
 	this->los_radius = los_radius;
 }
 
+void cache_provider::get_bounds(coord& start_x, coord& start_y, dimension& width, dimension& height) {
+	unique_lock<recursive_mutex> lck(this->mtx);
+
+	start_x = this->start_x;
+	start_y = this->start_y;
+	width = this->width;
+	height = this->height;
+}
+
+void cache_provider::resize(coord start_x, coord start_y, dimension width, dimension height) {
+	unique_lock<cache_provider> lck(*this);
+
+	this->set_bounds(start_x, start_y, width, height, this->los_radius);
+	this->rebound();
+}
+
+void cache_provider::extend_bounds(coord x, coord y, dimension width, dimension height) {
+	unique_lock<cache_provider> lck(*this);
+
+	if (this->width == 0 || this->height == 0) {
+		this->set_bounds(x, y, width, height, this->los_radius);
+		this->rebound();
+		return;
+	}
+
+	if (x >= this->start_x && y >= this->start_y && x + width <= this->end_x && y + height <= this->end_y)
+		return;
+
+	coord new_start_x = min(this->start_x, x);
+	coord new_start_y = min(this->start_y, y);
+	coord new_end_x = max(this->end_x, x + width);
+	coord new_end_y = max(this->end_y, y + height);
+
+	this->set_bounds(new_start_x, new_start_y, static_cast<dimension>(new_end_x - new_start_x), static_cast<dimension>(new_end_y - new_start_y), this->los_radius);
+	this->rebound();
+}
+
+vector<unique_ptr<map_obj>> cache_provider::release_area(coord x, coord y, dimension width, dimension height) {
+	if (this->lock_holder != this_thread::get_id())
+		throw sql::synchronization_exception();
+
+	vector<map_obj*> found;
+	vector<unique_ptr<map_obj>> result;
+
+	this->for_each_object([&found, x, y, width, height](base_obj* object) {
+		auto as_map = dynamic_cast<map_obj*>(object);
+		if (as_map && as_map->x >= x && as_map->y >= y && as_map->x < x + width && as_map->y < y + height)
+			found.push_back(as_map);
+	});
+
+	for (auto i : found) {
+		this->notify_border(i, true);
+		this->remove_internal(i);
+		this->remove_internal(static_cast<base_obj*>(i));
+		result.emplace_back(i);
+	}
+
+	return result;
+}
+
+void cache_provider::adopt(unique_ptr<map_obj> object) {
+	if (this->lock_holder != this_thread::get_id())
+		throw sql::synchronization_exception();
+
+	this->add_internal(static_cast<base_obj*>(object.get()));
+
+	if (!this->add_internal(object.get())) {
+		this->remove_internal(static_cast<base_obj*>(object.get()));
+		throw sql::synchronization_exception();
+	}
+
+	this->notify_border(object.release(), false);
+}
+
 cache_provider::~cache_provider() {
-	for (auto i : this->id_idx)
+	this->for_each_object([](base_obj* object) { delete object; });
+
+	this->halo_table.for_each([](base_obj* object) { delete object; });
+
+	for (auto i : this->halo_idx)
 		delete i.second;
 }
 
+void cache_provider::set_compact_mode(bool enabled) {
+	unique_lock<recursive_mutex> lck(this->mtx);
+
+	if (this->compact == enabled)
+		return;
+
+	vector<base_obj*> objects;
+	vector<map_obj*> halo;
+	this->for_each_object([&objects](base_obj* object) { objects.push_back(object); });
+	this->halo_table.for_each([&halo](base_obj* object) { halo.push_back(static_cast<map_obj*>(object)); });
+
+	for (auto& i : this->halo_idx)
+		halo.push_back(i.second);
+
+	this->id_idx.clear();
+	this->owner_idx.clear();
+	this->updatable_idx.clear();
+	this->loc_idx.clear();
+	this->halo_idx.clear();
+	this->compact_id_idx.clear();
+	this->compact_owner_idx.clear();
+	this->compact_loc_idx.clear();
+	this->compact_halo_idx.clear();
+	this->table.clear();
+	this->halo_table.clear();
+	this->compact = enabled;
+
+	for (auto i : objects)
+		this->add_internal(i);
+
+	for (auto i : objects) {
+		auto as_map = dynamic_cast<map_obj*>(i);
+		if (as_map)
+			this->add_internal(as_map);
+	}
+
+	for (auto i : halo)
+		this->add_halo_internal(i);
+}
+
+template<typename T> static word map_memory(const T& map) {
+	return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename T::value_type) + sizeof(void*));
+}
+
+cache_provider::memory_usage cache_provider::get_memory_usage() {
+	unique_lock<recursive_mutex> lck(this->mtx);
+
+	memory_usage usage;
+
+	usage.updatable_idx = this->updatable_idx.capacity() * sizeof(updatable*);
+
+	if (this->compact) {
+		usage.object_count = this->compact_id_idx.size();
+		usage.id_idx = this->compact_id_idx.memory();
+		usage.owner_idx = this->compact_owner_idx.memory();
+		usage.loc_idx = this->compact_loc_idx.memory();
+		usage.halo_idx = this->compact_halo_idx.memory() + this->halo_table.memory();
+		usage.object_table = this->table.memory();
+	}
+	else {
+		usage.object_count = this->id_idx.size();
+		usage.id_idx = map_memory(this->id_idx);
+		usage.owner_idx = map_memory(this->owner_idx);
+		usage.loc_idx = map_memory(this->loc_idx);
+		usage.halo_idx = map_memory(this->halo_idx);
+		usage.object_table = 0;
+
+		for (auto& i : this->owner_idx)
+			usage.owner_idx += i.second.capacity() * sizeof(base_obj*);
+
+		for (auto& i : this->loc_idx)
+			usage.loc_idx += map_memory(i.second);
+	}
+
+	return usage;
+}
+
+void cache_provider::set_halo(dimension width, function<void(const map_obj&, bool)> on_border_change, function<void()> on_border_flush) {
+	unique_lock<recursive_mutex> lck(this->mtx);
+
+	this->halo_width = width;
+	this->on_border_change = on_border_change;
+	this->on_border_flush = on_border_flush;
+}
+
+void cache_provider::notify_border(base_obj* object, bool removed, bool moved) {
+	if (!this->on_border_change || this->halo_width == 0)
+		return;
+
+	auto as_map = dynamic_cast<map_obj*>(object);
+	if (!as_map)
+		return;
+
+	bool near_border = as_map->x < this->start_x + this->halo_width || as_map->y < this->start_y + this->halo_width || as_map->x + as_map->width + this->halo_width > this->end_x || as_map->y + as_map->height + this->halo_width > this->end_y;
+
+	if (near_border)
+		this->on_border_change(*as_map, removed);
+	else if (moved || removed)
+		this->on_border_change(*as_map, true);
+}
+
+map_obj* cache_provider::find_halo(obj_id id) {
+	if (this->compact) {
+		auto handle = this->compact_halo_idx.find(id);
+
+		return handle != invalid_handle ? static_cast<map_obj*>(this->halo_table.get(handle)) : nullptr;
+	}
+
+	auto iter = this->halo_idx.find(id);
+
+	return iter != this->halo_idx.end() ? iter->second : nullptr;
+}
+
+void cache_provider::add_halo_internal(map_obj* object) {
+	obj_handle handle = invalid_handle;
+
+	if (this->compact) {
+		handle = this->halo_table.insert(object);
+		this->compact_halo_idx.insert(object->id, handle);
+		handle |= halo_handle_flag;
+	}
+	else {
+		this->halo_idx[object->id] = object;
+	}
+
+	this->place_halo(object, handle);
+}
+
+void cache_provider::place_halo(map_obj* object, obj_handle handle) {
+	coord min_x, min_y, max_x, max_y;
+	this->get_halo_bounds(min_x, min_y, max_x, max_y);
+
+	for (coord x = max(object->x, min_x); x < object->x + object->width && x < max_x; x++)
+		for (coord y = max(object->y, min_y); y < object->y + object->height && y < max_y; y++)
+			if (!this->is_location_in_bounds(x, y) && this->get_loc(x, y) == nullptr)
+				this->set_loc(x, y, object, handle);
+}
+
+void cache_provider::rebound() {
+	vector<map_obj*> halo;
+	this->halo_table.for_each([&halo](base_obj* object) { halo.push_back(static_cast<map_obj*>(object)); });
+
+	for (auto& i : this->halo_idx)
+		halo.push_back(i.second);
+
+	for (auto i : halo)
+		for (coord x = i->x; x < i->x + i->width; x++)
+			for (coord y = i->y; y < i->y + i->height; y++)
+				if (this->get_loc(x, y) == i)
+					this->clear_loc(x, y);
+
+	for (auto i : halo)
+		this->place_halo(i, this->compact ? this->compact_halo_idx.find(i->id) | halo_handle_flag : invalid_handle);
+
+	this->replay_border();
+}
+
+void cache_provider::remove_halo_internal(map_obj* object) {
+	for (coord x = object->x; x < object->x + object->width; x++)
+		for (coord y = object->y; y < object->y + object->height; y++)
+			if (this->get_loc(x, y) == object)
+				this->clear_loc(x, y);
+
+	if (this->compact) {
+		this->halo_table.erase(this->compact_halo_idx.find(object->id));
+		this->compact_halo_idx.erase(object->id);
+	}
+	else {
+		this->halo_idx.erase(object->id);
+	}
+
+	delete object;
+}
+
+void cache_provider::upsert_halo(unique_ptr<map_obj> object) {
+	unique_lock<recursive_mutex> lck(this->mtx);
+
+	auto existing = this->find_halo(object->id);
+	if (existing)
+		this->remove_halo_internal(existing);
+
+	this->add_halo_internal(object.release());
+}
+
+void cache_provider::remove_halo(obj_id id) {
+	unique_lock<recursive_mutex> lck(this->mtx);
+
+	auto existing = this->find_halo(id);
+	if (existing)
+		this->remove_halo_internal(existing);
+}
+
+void cache_provider::replay_border() {
+	unique_lock<cache_provider> lck(*this);
+
+	this->for_each_object([this](base_obj* object) { this->notify_border(object, false, true); });
+}
+
 void cache_provider::lock() {
 	this->mtx.lock();
 	this->lock_holder = this_thread::get_id();
+	this->lock_depth++;
 }
 
 void cache_provider::unlock() {
-	this->lock_holder = thread::id();
+	bool outermost = --this->lock_depth == 0;
+	bool flush = outermost && this->on_border_flush;
+
+	if (outermost)
+		this->lock_holder = thread::id();
+
 	this->mtx.unlock();
+
+	if (flush)
+		this->on_border_flush();
 }
 
 void cache_provider::begin_update(coord x, coord y, dimension width, dimension height) {
@@ -53,10 +338,65 @@ updatable* cache_provider::get_next_updatable(word position) {
 	return position < this->updatable_idx.size() ? this->updatable_idx[position] : nullptr;
 }
 
+base_obj* cache_provider::find_object(obj_id id) {
+	if (this->compact) {
+		auto handle = this->compact_id_idx.find(id);
+
+		return handle != invalid_handle ? this->table.get(handle) : nullptr;
+	}
+
+	auto iter = this->id_idx.find(id);
+
+	return iter != this->id_idx.end() ? iter->second : nullptr;
+}
+
+bool cache_provider::has_owner(owner_id owner) {
+	if (this->compact)
+		return this->compact_owner_idx.find(owner) != invalid_handle;
+
+	return this->owner_idx.count(owner) != 0;
+}
+
+void cache_provider::for_each_object(const function<void(base_obj*)>& callback) {
+	if (this->compact) {
+		this->table.for_each(callback);
+	}
+	else {
+		for (auto& i : this->id_idx)
+			callback(i.second);
+	}
+}
+
+void cache_provider::for_each_owned(owner_id owner, const function<void(base_obj*)>& callback) {
+	if (this->compact) {
+		for (auto handle = this->compact_owner_idx.find(owner); handle != invalid_handle; handle = this->table.next_owned(handle))
+			callback(this->table.get(handle));
+	}
+	else {
+		auto iter = this->owner_idx.find(owner);
+		if (iter != this->owner_idx.end())
+			for (auto i : iter->second)
+				callback(i);
+	}
+}
+
 void cache_provider::add_internal(base_obj* object) {
-	this->id_idx[object->id] = object;
+	if (this->compact) {
+		auto handle = this->table.insert(object);
+		auto head = this->compact_owner_idx.find(object->owner);
 
-	this->owner_idx[object->owner].push_back(object);
+		this->compact_id_idx.insert(object->id, handle);
+		this->table.next_owned(handle) = head;
+
+		if (head != invalid_handle)
+			this->table.prev_owned(head) = handle;
+
+		this->compact_owner_idx.insert(object->owner, handle);
+	}
+	else {
+		this->id_idx[object->id] = object;
+		this->owner_idx[object->owner].push_back(object);
+	}
 
 	auto as_updatable = dynamic_cast<updatable*>(object);
 	if (as_updatable)
@@ -69,21 +409,46 @@ bool cache_provider::add_internal(map_obj* object) {
 			if (this->get_loc(x, y) != nullptr)
 				return false;
 
+	auto handle = this->compact ? this->compact_id_idx.find(object->id) : invalid_handle;
+
 	for (coord x = object->x; x < object->x + object->width; x++)
 		for (coord y = object->y; y < object->y + object->height; y++)
-			this->get_loc(x, y) = object;
+			this->set_loc(x, y, object, handle);
 
 	return true;
 }
 
 void cache_provider::remove_internal(base_obj* object) {
-	this->id_idx.erase(object->id);
+	if (this->compact) {
+		auto handle = this->compact_id_idx.find(object->id);
 
-	if (object->owner != 0) {
-		auto& owner = this->owner_idx[object->owner];
-		auto iter = find(owner.begin(), owner.end(), object);
-		if (iter != owner.end())
-			owner.erase(iter);
+		if (handle != invalid_handle) {
+			auto next = this->table.next_owned(handle);
+			auto prev = this->table.prev_owned(handle);
+
+			if (prev != invalid_handle)
+				this->table.next_owned(prev) = next;
+			else if (next != invalid_handle)
+				this->compact_owner_idx.insert(object->owner, next);
+			else
+				this->compact_owner_idx.erase(object->owner);
+
+			if (next != invalid_handle)
+				this->table.prev_owned(next) = prev;
+
+			this->compact_id_idx.erase(object->id);
+			this->table.erase(handle);
+		}
+	}
+	else {
+		this->id_idx.erase(object->id);
+
+		if (object->owner != 0) {
+			auto& owner = this->owner_idx[object->owner];
+			auto iter = find(owner.begin(), owner.end(), object);
+			if (iter != owner.end())
+				owner.erase(iter);
+		}
 	}
 
 	auto as_updatable = dynamic_cast<updatable*>(object);
@@ -97,31 +462,87 @@ void cache_provider::remove_internal(base_obj* object) {
 void cache_provider::remove_internal(map_obj* object) {
 	for (coord x = object->x; x < object->x + object->width; x++)
 		for (coord y = object->y; y < object->y + object->height; y++)
-			this->get_loc(x, y) = nullptr;
+			this->clear_loc(x, y);
 }
 
-map_obj*& cache_provider::get_loc(coord x, coord y) {
-	return this->loc_idx[x][y];
+uint64 cache_provider::tile_key(coord x, coord y) {
+	return (x << 32) | (y & 0xFFFFFFFF);
+}
+
+map_obj* cache_provider::get_loc(coord x, coord y) {
+	if (this->compact) {
+		auto handle = this->compact_loc_idx.find(cache_provider::tile_key(x, y));
+
+		if (handle == invalid_handle)
+			return nullptr;
+
+		if (handle & halo_handle_flag)
+			return static_cast<map_obj*>(this->halo_table.get(handle & ~halo_handle_flag));
+
+		return static_cast<map_obj*>(this->table.get(handle));
+	}
+
+	auto column = this->loc_idx.find(x);
+	if (column == this->loc_idx.end())
+		return nullptr;
+
+	auto iter = column->second.find(y);
+
+	return iter != column->second.end() ? iter->second : nullptr;
+}
+
+void cache_provider::set_loc(coord x, coord y, map_obj* object, obj_handle handle) {
+	if (this->compact)
+		this->compact_loc_idx.insert(cache_provider::tile_key(x, y), handle);
+	else
+		this->loc_idx[x][y] = object;
+}
+
+void cache_provider::clear_loc(coord x, coord y) {
+	if (this->compact) {
+		this->compact_loc_idx.erase(cache_provider::tile_key(x, y));
+		return;
+	}
+
+	auto column = this->loc_idx.find(x);
+	if (column == this->loc_idx.end())
+		return;
+
+	column->second.erase(y);
+
+	if (column->second.empty())
+		this->loc_idx.erase(column);
 }
 
 bool cache_provider::is_root_object(map_obj* obj, coord x, coord y) {
 	return obj->x == x && obj->y == y;
 }
 
+void cache_provider::get_halo_bounds(coord& min_x, coord& min_y, coord& max_x, coord& max_y) {
+	min_x = this->start_x > this->halo_width ? this->start_x - this->halo_width : 0;
+	min_y = this->start_y > this->halo_width ? this->start_y - this->halo_width : 0;
+	max_x = this->end_x + this->halo_width;
+	max_y = this->end_y + this->halo_width;
+}
+
 void cache_provider::clamp(coord& start_x, coord& start_y, coord& end_x, coord& end_y) {
-	if (start_x < this->start_x) start_x = this->start_x;
-	if (start_y < this->start_y) start_y = this->start_y;
-	if (end_x >= this->end_x) end_x = this->end_x - 1;
-	if (end_y >= this->end_y) end_y = this->end_y - 1;
+	coord min_x, min_y, max_x, max_y;
+	this->get_halo_bounds(min_x, min_y, max_x, max_y);
+
+	if (start_x < min_x) start_x = min_x;
+	if (start_y < min_y) start_y = min_y;
+	if (end_x >= max_x) end_x = max_x - 1;
+	if (end_y >= max_y) end_y = max_y - 1;
 }
 
 unique_ptr<base_obj> cache_provider::get_by_id(obj_id search_id) {
 	unique_lock<recursive_mutex> lck(this->mtx);
 
-	if (this->id_idx.count(search_id) == 0)
+	auto object = this->find_object(search_id);
+	if (!object)
 		return nullptr;
 
-	return unique_ptr<base_obj>(this->id_idx[search_id]->clone());
+	return unique_ptr<base_obj>(object->clone());
 }
 
 unique_ptr<map_obj> cache_provider::get_at_location(coord x, coord y) {
@@ -157,9 +578,7 @@ unordered_map<obj_id, unique_ptr<base_obj>> cache_provider::get_by_owner(owner_i
 	unordered_map<obj_id, unique_ptr<base_obj>> result;
 
 	unique_lock<recursive_mutex> lck(this->mtx);
-	if (this->owner_idx.count(owner) != 0)
-		for (auto i : this->owner_idx[owner])
-			result.emplace(i->id, unique_ptr<base_obj>(i->clone()));
+	this->for_each_owned(owner, [&result](base_obj* object) { result.emplace(object->id, unique_ptr<base_obj>(object->clone())); });
 
 	return result;
 }
@@ -168,15 +587,18 @@ unordered_map<obj_id, unique_ptr<map_obj>> cache_provider::get_in_owner_los(owne
 	unordered_map<obj_id, unique_ptr<map_obj>> result;
 
 	unique_lock<recursive_mutex> lck(this->mtx);
-	if (this->owner_idx.count(owner) == 0)
+	if (!this->has_owner(owner))
 		return result;
 
-	auto& owner_objects = this->owner_idx[owner];
+	vector<map_obj*> owner_objects;
+	this->for_each_owned(owner, [&owner_objects](base_obj* object) {
+		auto as_map = dynamic_cast<map_obj*>(object);
+		if (as_map)
+			owner_objects.push_back(as_map);
+	});
+
 	coord start_x, start_y, end_x, end_y, x, y;
-	for (auto object : owner_objects) {
-		auto current_object = dynamic_cast<map_obj*>(object);
-		if (!current_object)
-			continue;
+	for (auto current_object : owner_objects) {
 
 		start_x = current_object->x - this->los_radius;
 		start_y = current_object->y - this->los_radius;
@@ -270,5 +692,5 @@ bool cache_provider::is_location_in_bounds(coord x, coord y, dimension width, di
 
 bool cache_provider::is_user_present(obj_id user_id) {
 	unique_lock<recursive_mutex> lck(this->mtx);
-	return this->owner_idx.count(user_id) != 0;
+	return this->has_owner(user_id);
 }
\ No newline at end of file
@@ -9,11 +9,13 @@
 #include <memory>
 #include <thread>
 #include <type_traits>
+#include <functional>
 
 #include <ArkeIndustries.CPPUtilities/Common.h>
 
 #include "Common.h"
 #include "Objects.h"
+#include "CompactIndex.h"
 
 namespace game_server {
 	class cache_provider {
@@ -27,13 +29,41 @@ namespace game_server {
 
 		std::thread::id lock_holder;
 		std::recursive_mutex mtx;
+		word lock_depth = 0;
 
 		std::vector<objects::updatable*> updatable_idx;
 		std::unordered_map<obj_id, objects::base_obj*> id_idx;
 		std::unordered_map<owner_id, std::vector<objects::base_obj*>> owner_idx;
 		std::unordered_map<coord, std::unordered_map<coord, objects::map_obj*>> loc_idx;
-
-		objects::map_obj*& get_loc(coord x, coord y);
+		std::unordered_map<obj_id, objects::map_obj*> halo_idx;
+
+		bool compact = false;
+		object_table table;
+		compact_map compact_id_idx;
+		compact_map compact_owner_idx;
+		compact_map compact_loc_idx;
+		object_table halo_table;
+		compact_map compact_halo_idx;
+
+		dimension halo_width = 0;
+		std::function<void(const objects::map_obj&, bool)> on_border_change;
+		std::function<void()> on_border_flush;
+
+		static uint64 tile_key(coord x, coord y);
+		objects::map_obj* get_loc(coord x, coord y);
+		void set_loc(coord x, coord y, objects::map_obj* object, obj_handle handle);
+		void clear_loc(coord x, coord y);
+		objects::map_obj* find_halo(obj_id id);
+		objects::base_obj* find_object(obj_id id);
+		bool has_owner(owner_id owner);
+		void for_each_object(const std::function<void(objects::base_obj*)>& callback);
+		void for_each_owned(owner_id owner, const std::function<void(objects::base_obj*)>& callback);
+		void notify_border(objects::base_obj* object, bool removed, bool moved = false);
+		void add_halo_internal(objects::map_obj* object);
+		void place_halo(objects::map_obj* object, obj_handle handle);
+		void rebound();
+		void remove_halo_internal(objects::map_obj* object);
+		void get_halo_bounds(coord& min_x, coord& min_y, coord& max_x, coord& max_y);
 		bool is_root_object(objects::map_obj* obj, coord x, coord y);
 
 		void add_internal(objects::base_obj* object);
@@ -46,6 +76,16 @@ namespace game_server {
 		friend class cache_updater;
 
 		public:
+			struct memory_usage {
+				word object_count;
+				word updatable_idx;
+				word id_idx;
+				word owner_idx;
+				word loc_idx;
+				word halo_idx;
+				word object_table;
+			};
+
 			cache_provider(const cache_provider& other) = delete;
 			cache_provider(cache_provider&& other) = delete;
 			cache_provider& operator=(cache_provider&& other) = delete;
@@ -56,6 +96,20 @@ namespace game_server {
 			virtual ~cache_provider();
 
 			void set_bounds(coord start_x, coord start_y, dimension width, dimension height, dimension los_radius);
+			void get_bounds(coord& start_x, coord& start_y, dimension& width, dimension& height);
+			void resize(coord start_x, coord start_y, dimension width, dimension height);
+			void extend_bounds(coord x, coord y, dimension width, dimension height);
+
+			std::vector<std::unique_ptr<objects::map_obj>> release_area(coord x, coord y, dimension width, dimension height);
+			void adopt(std::unique_ptr<objects::map_obj> object);
+
+			void set_compact_mode(bool enabled);
+			memory_usage get_memory_usage();
+
+			void set_halo(dimension width, std::function<void(const objects::map_obj&, bool)> on_border_change, std::function<void()> on_border_flush);
+			void upsert_halo(std::unique_ptr<objects::map_obj> object);
+			void remove_halo(obj_id id);
+			void replay_border();
 
 			void lock();
 			void unlock();
@@ -83,10 +137,7 @@ namespace game_server {
 
 				std::unique_lock<std::recursive_mutex> lck(this->mtx);
 
-				if (this->id_idx.count(search_id) == 0)
-					return T();
-
-				T* result = dynamic_cast<T*>(this->id_idx[search_id]);
+				T* result = dynamic_cast<T*>(this->find_object(search_id));
 				if (!result)
 					return T();
 
@@ -103,14 +154,17 @@ namespace game_server {
 				objects::base_obj* as_base = new_obj;
 				objects::map_obj* as_map = dynamic_cast<objects::map_obj*>(new_obj);
 
+				this->add_internal(as_base);
+
 				if (as_map) {
 					if (!this->add_internal(as_map)) {
+						this->remove_internal(as_base);
 						delete new_obj;
 						throw util::sql::synchronization_exception();
 					}
 				}
 
-				this->add_internal(as_base);
+				this->notify_border(as_base, false);
 			}
 
 			template<typename T> void remove(T& type) {
@@ -119,13 +173,17 @@ namespace game_server {
 				if (this->lock_holder != std::this_thread::get_id())
 					throw util::sql::synchronization_exception();
 
-				objects::base_obj* as_base = this->id_idx[type.id];
+				objects::base_obj* as_base = this->find_object(type.id);
+				if (!as_base)
+					throw util::sql::synchronization_exception();
 
 				if (type.last_updated_by_cache != as_base->last_updated_by_cache)
 					throw util::sql::synchronization_exception();
 
 				objects::map_obj* as_map = dynamic_cast<objects::map_obj*>(as_base);
 
+				this->notify_border(as_base, true);
+
 				if (as_map)
 					this->remove_internal(as_map);
 
@@ -138,11 +196,15 @@ namespace game_server {
 				if (this->lock_holder != std::this_thread::get_id())
 					throw util::sql::synchronization_exception();
 
-				objects::base_obj* orig = this->id_idx[object.id];
+				objects::base_obj* orig = this->find_object(object.id);
+				if (!orig)
+					throw util::sql::synchronization_exception();
+
 				objects::map_obj* orig_as_map = dynamic_cast<objects::map_obj*>(orig);
 				objects::map_obj* obj_as_map = dynamic_cast<objects::map_obj*>(&object);
 				bool loc_changed = obj_as_map && (obj_as_map->x != orig_as_map->x || obj_as_map->y != orig_as_map->y);
 				bool own_changed = orig->owner != object.owner;
+				bool reindex = loc_changed || (own_changed && orig_as_map);
 
 				if (orig->last_updated_by_cache != object.last_updated_by_cache)
 					throw util::sql::synchronization_exception();
@@ -155,7 +217,7 @@ namespace game_server {
 
 				object.last_updated_by_cache = date_time::clock::now();
 
-				if (loc_changed)
+				if (reindex)
 					this->remove_internal(orig_as_map);
 
 				if (own_changed)
@@ -163,11 +225,13 @@ namespace game_server {
 
 				*orig = object;
 
-				if (loc_changed)
-					this->add_internal(orig_as_map);
-
 				if (own_changed)
 					this->add_internal(orig);
+
+				if (reindex)
+					this->add_internal(orig_as_map);
+
+				this->notify_border(orig, false, loc_changed);
 			}
 
 			template<typename T> void add(std::unique_ptr<T>& object) {
@@ -191,49 +255,49 @@ namespace game_server {
 			template<typename T> void add_single(std::unique_ptr<T>& object) {
 				static_assert(std::is_base_of<objects::base_obj, T>::value, "typename T must derive from objects::base_obj.");
 
-				this->begin_update();
+				std::unique_lock<cache_provider> lck(*this);
+
 				this->add(object);
-				this->end_update();
 			}
 
 			template<typename T> void add_single(T& object) {
 				static_assert(std::is_base_of<objects::base_obj, T>::value, "typename T must derive from objects::base_obj.");
 
-				this->begin_update();
+				std::unique_lock<cache_provider> lck(*this);
+
 				this->add(object);
-				this->end_update();
 			}
 
 			template<typename T> void remove_single(std::unique_ptr<T>& object) {
 				static_assert(std::is_base_of<objects::base_obj, T>::value, "typename T must derive from objects::base_obj.");
 
-				this->begin_update();
+				std::unique_lock<cache_provider> lck(*this);
+
 				this->add(object);
-				this->end_update();
 			}
 
 			template<typename T> void remove_single(T& object) {
 				static_assert(std::is_base_of<objects::base_obj, T>::value, "typename T must derive from objects::base_obj.");
 
-				this->begin_update();
+				std::unique_lock<cache_provider> lck(*this);
+
 				this->add(object);
-				this->end_update();
 			}
 
 			template<typename T> void update_single(std::unique_ptr<T>& object) {
 				static_assert(std::is_base_of<objects::base_obj, T>::value, "typename T must derive from objects::base_obj.");
 
-				this->begin_update();
+				std::unique_lock<cache_provider> lck(*this);
+
 				this->update(object);
-				this->end_update();
 			}
 
 			template<typename T> void update_single(T& object) {
 				static_assert(std::is_base_of<objects::base_obj, T>::value, "typename T must derive from objects::base_obj.");
 
-				this->begin_update();
+				std::unique_lock<cache_provider> lck(*this);
+
 				this->update(object);
-				this->end_update();
 			}
 	};
 }
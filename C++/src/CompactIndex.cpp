@@ -0,0 +1,152 @@
+#include "CompactIndex.h"
+
+using namespace std;
+using namespace game_server;
+using namespace game_server::objects;
+
+compact_map::compact_map() : count(0), mask(0) {
+
+}
+
+word compact_map::slot(uint64 key, word mask) {
+	key += 0x9E3779B97F4A7C15ULL;
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+
+	return static_cast<word>(key ^ (key >> 31)) & mask;
+}
+
+void compact_map::grow() {
+	vector<uint64> old_keys;
+	vector<obj_handle> old_values;
+	old_keys.swap(this->keys);
+	old_values.swap(this->values);
+
+	word capacity = old_values.empty() ? 16 : old_values.size() * 2;
+
+	this->keys.assign(capacity, 0);
+	this->values.assign(capacity, invalid_handle);
+	this->mask = capacity - 1;
+	this->count = 0;
+
+	for (word i = 0; i < old_values.size(); i++)
+		if (old_values[i] != invalid_handle)
+			this->insert(old_keys[i], old_values[i]);
+}
+
+obj_handle compact_map::find(uint64 key) const {
+	if (this->values.empty())
+		return invalid_handle;
+
+	for (word i = compact_map::slot(key, this->mask); ; i = (i + 1) & this->mask) {
+		if (this->values[i] == invalid_handle)
+			return invalid_handle;
+
+		if (this->keys[i] == key)
+			return this->values[i];
+	}
+}
+
+void compact_map::insert(uint64 key, obj_handle value) {
+	if ((this->count + 1) * 4 > this->values.size() * 3)
+		this->grow();
+
+	for (word i = compact_map::slot(key, this->mask); ; i = (i + 1) & this->mask) {
+		if (this->values[i] == invalid_handle) {
+			this->keys[i] = key;
+			this->values[i] = value;
+			this->count++;
+			return;
+		}
+
+		if (this->keys[i] == key) {
+			this->values[i] = value;
+			return;
+		}
+	}
+}
+
+bool compact_map::erase(uint64 key) {
+	if (this->values.empty())
+		return false;
+
+	word i = compact_map::slot(key, this->mask);
+	for (; this->keys[i] != key || this->values[i] == invalid_handle; i = (i + 1) & this->mask)
+		if (this->values[i] == invalid_handle)
+			return false;
+
+	for (word j = (i + 1) & this->mask; this->values[j] != invalid_handle; j = (j + 1) & this->mask) {
+		word home = compact_map::slot(this->keys[j], this->mask);
+
+		if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+			this->keys[i] = this->keys[j];
+			this->values[i] = this->values[j];
+			i = j;
+		}
+	}
+
+	this->values[i] = invalid_handle;
+	this->count--;
+
+	return true;
+}
+
+void compact_map::clear() {
+	this->keys.clear();
+	this->keys.shrink_to_fit();
+	this->values.clear();
+	this->values.shrink_to_fit();
+	this->count = 0;
+	this->mask = 0;
+}
+
+word compact_map::size() const {
+	return this->count;
+}
+
+word compact_map::memory() const {
+	return this->keys.capacity() * sizeof(uint64) + this->values.capacity() * sizeof(obj_handle);
+}
+
+obj_handle object_table::insert(base_obj* object) {
+	obj_handle handle;
+
+	if (!this->free_slots.empty()) {
+		handle = this->free_slots.back();
+		this->free_slots.pop_back();
+	}
+	else {
+		handle = static_cast<obj_handle>(this->slots.size());
+		this->slots.emplace_back();
+	}
+
+	this->slots[handle] = slot { object, invalid_handle, invalid_handle };
+
+	return handle;
+}
+
+void object_table::erase(obj_handle handle) {
+	this->slots[handle] = slot { nullptr, invalid_handle, invalid_handle };
+	this->free_slots.push_back(handle);
+}
+
+void object_table::clear() {
+	this->slots.clear();
+	this->free_slots.clear();
+}
+
+base_obj* object_table::get(obj_handle handle) const {
+	return this->slots[handle].object;
+}
+
+obj_handle& object_table::next_owned(obj_handle handle) {
+	return this->slots[handle].next_owned;
+}
+
+obj_handle& object_table::prev_owned(obj_handle handle) {
+	return this->slots[handle].prev_owned;
+}
+
+word object_table::memory() const {
+	return this->slots.capacity() * sizeof(slot) + this->free_slots.capacity() * sizeof(obj_handle);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+
+#include "Common.h"
+#include "Objects.h"
+
+namespace game_server {
+	typedef uint32 obj_handle;
+
+	static const obj_handle invalid_handle = 0xFFFFFFFF;
+	static const obj_handle halo_handle_flag = 0x80000000;
+
+	class compact_map {
+		std::vector<uint64> keys;
+		std::vector<obj_handle> values;
+		word count;
+		word mask;
+
+		static word slot(uint64 key, word mask);
+		void grow();
+
+		public:
+			compact_map();
+			~compact_map() = default;
+
+			obj_handle find(uint64 key) const;
+			void insert(uint64 key, obj_handle value);
+			bool erase(uint64 key);
+			void clear();
+
+			word size() const;
+			word memory() const;
+	};
+
+	class object_table {
+		struct slot {
+			objects::base_obj* object;
+			obj_handle next_owned;
+			obj_handle prev_owned;
+		};
+
+		std::vector<slot> slots;
+		std::vector<obj_handle> free_slots;
+
+		public:
+			object_table() = default;
+			~object_table() = default;
+
+			obj_handle insert(objects::base_obj* object);
+			void erase(obj_handle handle);
+			void clear();
+
+			objects::base_obj* get(obj_handle handle) const;
+			obj_handle& next_owned(obj_handle handle);
+			obj_handle& prev_owned(obj_handle handle);
+
+			template<typename F> void for_each(F callback) const {
+				for (auto& i : this->slots)
+					if (i.object)
+						callback(i.object);
+			}
+
+			word memory() const;
+	};
+}
@@ -0,0 +1,131 @@
+#include "HaloReplication.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace util;
+using namespace game_server;
+using namespace game_server::objects;
+
+const uint8 halo_replicator::halo_method;
+const uint8 halo_replicator::halo_request_method;
+
+halo_replicator::halo_replicator(processor_node& node, cache_provider& cache, dimension los_radius, vector<neighbour> neighbours, area_migrator::object_writer writer, area_migrator::object_reader reader) : node(node), cache(cache), writer(writer), reader(reader), neighbours(neighbours), halo_width(los_radius) {
+	this->node.set_control_handler(halo_replicator::halo_method, bind(&halo_replicator::on_halo, this, placeholders::_1));
+	this->node.set_control_handler(halo_replicator::halo_request_method, bind(&halo_replicator::on_halo_request, this, placeholders::_1));
+	this->cache.set_halo(los_radius, bind(&halo_replicator::on_border_change, this, placeholders::_1, placeholders::_2), bind(&halo_replicator::flush, this));
+}
+
+void halo_replicator::bootstrap() {
+	vector<obj_id> areas;
+
+	{
+		unique_lock<cache_provider> lck(this->cache);
+
+		for (auto& i : this->neighbours)
+			areas.push_back(i.area);
+
+		this->cache.replay_border();
+	}
+
+	if (!areas.empty())
+		this->node.send_to_broker(areas, this->node.create_message(0x00, halo_replicator::halo_request_method));
+}
+
+void halo_replicator::set_neighbours(vector<neighbour> neighbours) {
+	{
+		unique_lock<cache_provider> lck(this->cache);
+
+		this->neighbours = neighbours;
+	}
+
+	this->bootstrap();
+}
+
+bool halo_replicator::touches(const neighbour& area, const map_obj& object) const {
+	return object.x + object.width + this->halo_width > area.start_x && object.x < area.start_x + area.width + this->halo_width && object.y + object.height + this->halo_width > area.start_y && object.y < area.start_y + area.height + this->halo_width;
+}
+
+void halo_replicator::on_border_change(const map_obj& object, bool removed) {
+	vector<obj_id> targets;
+	vector<obj_id> stale;
+
+	if (!removed)
+		for (auto& i : this->neighbours)
+			if (this->touches(i, object))
+				targets.push_back(i.area);
+
+	auto iter = this->replicated.find(object.id);
+	if (iter != this->replicated.end()) {
+		for (auto i : iter->second)
+			if (find(targets.begin(), targets.end(), i) == targets.end())
+				stale.push_back(i);
+
+		if (targets.empty())
+			this->replicated.erase(iter);
+	}
+
+	if (!targets.empty())
+		this->replicated[object.id] = targets;
+
+	if (!stale.empty()) {
+		auto message = this->node.create_message(0x00, halo_replicator::halo_method);
+
+		message.write(static_cast<uint8>(1));
+		message.write(object.id);
+
+		unique_lock<mutex> lck(this->deltas_lock);
+		this->deltas.push_back(delta { move(stale), move(message) });
+	}
+
+	if (!targets.empty()) {
+		auto message = this->node.create_message(0x00, halo_replicator::halo_method);
+
+		message.write(static_cast<uint8>(0));
+		message.write(object.id);
+		this->writer(object, message);
+
+		unique_lock<mutex> lck(this->deltas_lock);
+		this->deltas.push_back(delta { move(targets), move(message) });
+	}
+}
+
+void halo_replicator::flush() {
+	{
+		unique_lock<mutex> lck(this->deltas_lock);
+
+		if (this->deltas.empty())
+			return;
+	}
+
+	unique_lock<mutex> lck(this->send_lock);
+	vector<delta> ready;
+
+	{
+		unique_lock<mutex> deltas_lck(this->deltas_lock);
+		ready.swap(this->deltas);
+	}
+
+	for (auto& i : ready) {
+		try {
+			this->node.send_to_broker(i.targets, move(i.message));
+		}
+		catch (const processor_node::broker_node_down_exception&) {
+
+		}
+	}
+}
+
+void halo_replicator::on_halo(data_stream& message) {
+	auto removed = message.read<uint8>() != 0;
+	auto id = message.read<obj_id>();
+
+	if (removed)
+		this->cache.remove_halo(id);
+	else
+		this->cache.upsert_halo(this->reader(message));
+}
+
+void halo_replicator::on_halo_request(data_stream& message) {
+	this->cache.replay_border();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+#include <ArkeIndustries.CPPUtilities/DataStream.h>
+
+#include "Common.h"
+#include "Objects.h"
+#include "CacheProvider.h"
+#include "ProcessorNode.h"
+#include "AreaMigration.h"
+
+namespace game_server {
+	class halo_replicator {
+		public:
+			static const uint8 halo_method = 0x04;
+			static const uint8 halo_request_method = 0x06;
+
+			struct neighbour {
+				obj_id area;
+				coord start_x;
+				coord start_y;
+				dimension width;
+				dimension height;
+			};
+
+		private:
+			struct delta {
+				std::vector<obj_id> targets;
+				util::data_stream message;
+			};
+
+			processor_node& node;
+			cache_provider& cache;
+			area_migrator::object_writer writer;
+			area_migrator::object_reader reader;
+			std::vector<neighbour> neighbours;
+			std::unordered_map<obj_id, std::vector<obj_id>> replicated;
+			dimension halo_width;
+			std::vector<delta> deltas;
+			std::mutex deltas_lock;
+			std::mutex send_lock;
+
+			bool touches(const neighbour& area, const objects::map_obj& object) const;
+			void on_border_change(const objects::map_obj& object, bool removed);
+			void flush();
+			void on_halo(util::data_stream& message);
+			void on_halo_request(util::data_stream& message);
+
+		public:
+			halo_replicator(const halo_replicator& other) = delete;
+			halo_replicator(halo_replicator&& other) = delete;
+			halo_replicator& operator=(halo_replicator&& other) = delete;
+			halo_replicator& operator=(const halo_replicator& other) = delete;
+
+			halo_replicator(processor_node& node, cache_provider& cache, dimension los_radius, std::vector<neighbour> neighbours, area_migrator::object_writer writer, area_migrator::object_reader reader);
+			~halo_replicator() = default;
+
+			void bootstrap();
+			void set_neighbours(std::vector<neighbour> neighbours);
+	};
+}
@@ -0,0 +1,75 @@
+#include "HashRing.h"
+
+using namespace std;
+using namespace game_server;
+
+hash_ring::hash_ring(word members, word replicas) {
+	this->reset(members, replicas);
+}
+
+uint64 hash_ring::mix(uint64 value) {
+	value += 0x9E3779B97F4A7C15ULL;
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+
+	return value ^ (value >> 31);
+}
+
+void hash_ring::reset(word members, word replicas) {
+	this->ring.clear();
+	this->member_count = 0;
+	this->replicas = replicas;
+
+	for (word i = 0; i < members; i++)
+		this->add(i);
+}
+
+void hash_ring::add(word member) {
+	if (this->contains(member))
+		return;
+
+	for (word j = 0; j < this->replicas; j++)
+		this->ring[hash_ring::mix((static_cast<uint64>(member) << 32) | j)] = member;
+
+	this->member_count++;
+}
+
+void hash_ring::remove(word member) {
+	bool found = false;
+
+	for (auto i = this->ring.begin(); i != this->ring.end(); ) {
+		if (i->second == member) {
+			i = this->ring.erase(i);
+			found = true;
+		}
+		else {
+			++i;
+		}
+	}
+
+	if (found)
+		this->member_count--;
+}
+
+bool hash_ring::contains(word member) const {
+	for (auto& i : this->ring)
+		if (i.second == member)
+			return true;
+
+	return false;
+}
+
+word hash_ring::owner(obj_id id) const {
+	if (this->ring.empty())
+		return 0;
+
+	auto iter = this->ring.lower_bound(hash_ring::mix(id));
+	if (iter == this->ring.end())
+		iter = this->ring.begin();
+
+	return iter->second;
+}
+
+word hash_ring::size() const {
+	return this->member_count;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <map>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+
+#include "Common.h"
+
+namespace game_server {
+	class hash_ring {
+		std::map<uint64, word> ring;
+		word member_count;
+		word replicas;
+
+		static uint64 mix(uint64 value);
+
+		public:
+			hash_ring(word members = 0, word replicas = 64);
+			~hash_ring() = default;
+
+			void reset(word members, word replicas = 64);
+			void add(word member);
+			void remove(word member);
+			bool contains(word member) const;
+			word owner(obj_id id) const;
+			word size() const;
+	};
+}
@@ -0,0 +1,428 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+#include <ArkeIndustries.CPPUtilities/DataStream.h>
+#include <ArkeIndustries.CPPUtilities/Net/RequestServer.h>
+#include <ArkeIndustries.CPPUtilities/Net/TCPConnection.h>
+
+#include "Common.h"
+#include "ProcessorNode.h"
+#include "BrokerNode.h"
+
+using namespace std;
+using namespace util;
+using namespace util::net;
+using namespace game_server;
+
+struct stub_context {
+	static chrono::microseconds statement_latency;
+
+	bool in_transaction = false;
+
+	void begin_transaction(sql::connection::isolation_level level) {
+		this_thread::sleep_for(stub_context::statement_latency);
+		this->in_transaction = true;
+	}
+
+	void commit_transaction() {
+		this_thread::sleep_for(stub_context::statement_latency);
+		this->in_transaction = false;
+	}
+
+	void rollback_transaction() {
+		this->in_transaction = false;
+	}
+
+	bool committed() const {
+		return !this->in_transaction;
+	}
+
+	void query() {
+		this_thread::sleep_for(stub_context::statement_latency);
+	}
+};
+
+chrono::microseconds stub_context::statement_latency(100);
+
+typedef processor_node_db<stub_context> load_node;
+
+static const uint8 login_category = 0x01;
+static const uint8 work_category = 0x02;
+static const uint8 relay_category = 0x03;
+
+static const obj_id first_user_id = 1000000;
+
+static vector<unique_ptr<load_node>> nodes;
+static chrono::microseconds handler_work(20);
+
+static load_node& node_of(obj_id user_id) {
+	return *nodes[(user_id - first_user_id) % nodes.size()];
+}
+
+struct login_handler : public load_node::base_handler {
+	obj_id requested;
+
+	virtual void deserialize(data_stream& parameters) override {
+		this->requested = parameters.read<obj_id>();
+	}
+
+	virtual result_code process(obj_id& user_id, stub_context& db) override {
+		user_id = this->requested;
+		return result_codes::success;
+	}
+
+	virtual void serialize(data_stream& response) override {
+
+	}
+};
+
+struct cache_handler : public load_node::base_handler {
+	uint32 payload;
+
+	virtual void deserialize(data_stream& parameters) override {
+		this->payload = parameters.read<uint32>();
+	}
+
+	virtual result_code process(obj_id& user_id, stub_context& db) override {
+		auto until = chrono::steady_clock::now() + handler_work;
+		while (chrono::steady_clock::now() < until)
+			;
+
+		return result_codes::success;
+	}
+
+	virtual void serialize(data_stream& response) override {
+		for (uint32 i = 0; i < this->payload; i++)
+			response.write(static_cast<uint8>(i));
+	}
+};
+
+struct db_handler : public load_node::base_handler {
+	virtual void deserialize(data_stream& parameters) override {
+
+	}
+
+	virtual result_code process(obj_id& user_id, stub_context& db) override {
+		db.query();
+		return result_codes::success;
+	}
+
+	virtual void serialize(data_stream& response) override {
+
+	}
+};
+
+struct relay_handler : public load_node::base_handler {
+	obj_id recipient;
+
+	virtual void deserialize(data_stream& parameters) override {
+		this->recipient = parameters.read<obj_id>();
+	}
+
+	virtual result_code process(obj_id& user_id, stub_context& db) override {
+		if (this->recipient < first_user_id)
+			return result_codes::success;
+
+		auto& node = node_of(user_id);
+		auto message = node.create_message(relay_category, 0x01);
+
+		message.write(this->recipient);
+		node.send_to_broker((this->recipient - first_user_id) % nodes.size() + 1, move(message));
+
+		return result_codes::success;
+	}
+
+	virtual void serialize(data_stream& response) override {
+
+	}
+};
+
+struct relay_sink_handler : public load_node::base_handler {
+	obj_id recipient;
+
+	virtual void deserialize(data_stream& parameters) override {
+		this->recipient = parameters.read<obj_id>();
+	}
+
+	virtual result_code process(obj_id& user_id, stub_context& db) override {
+		if (this->recipient >= first_user_id) {
+			auto& node = node_of(this->recipient);
+			node.send(this->recipient, node.create_message(relay_category, 0x01));
+		}
+
+		return result_codes::no_response;
+	}
+
+	virtual void serialize(data_stream& response) override {
+
+	}
+};
+
+struct load_config {
+	string address = "127.0.0.1";
+	word base_port = 23000;
+	word areas = 0;
+	word brokers = 1;
+	word node_workers = 8;
+	word client_workers = 4;
+	word clients = 1000;
+	word depth = 4;
+	word seconds = 10;
+	word cache_weight = 70;
+	word db_weight = 25;
+	word relay_weight = 5;
+	word payload = 64;
+};
+
+struct client_state {
+	shared_ptr<tcp_connection> connection;
+	atomic<word> in_flight;
+	uint32 next_sequence;
+	vector<atomic<int64>> sent;
+
+	client_state(word slots) : sent(slots) {
+		this->in_flight = 0;
+		this->next_sequence = 0;
+	}
+
+	void mark_sent(uint32 sequence, chrono::steady_clock::time_point at) {
+		this->sent[sequence % this->sent.size()].store(at.time_since_epoch().count(), memory_order_release);
+	}
+
+	chrono::steady_clock::time_point sent_at(uint32 sequence) const {
+		return chrono::steady_clock::time_point(chrono::steady_clock::duration(this->sent[sequence % this->sent.size()].load(memory_order_acquire)));
+	}
+};
+
+struct latency_log {
+	mutex lock;
+	unordered_map<uint16, vector<int64>> samples;
+	atomic<uint64> notifications;
+	atomic<uint64> failures;
+};
+
+static const uint32 sequence_bits = 20;
+static const word max_clients = static_cast<word>(1) << (32 - sequence_bits);
+
+static void report(const string& name, vector<int64>& samples, word seconds) {
+	if (samples.empty())
+		return;
+
+	sort(samples.begin(), samples.end());
+
+	auto percentile = [&samples](double p) { return samples[min<word>(samples.size() - 1, static_cast<word>(p * samples.size()))]; };
+
+	cout << "{\"handler\":\"" << name << "\",\"requests\":" << samples.size() << ",\"throughput\":" << samples.size() / max<word>(seconds, 1) << ",\"p50_us\":" << percentile(0.50) << ",\"p99_us\":" << percentile(0.99) << ",\"p999_us\":" << percentile(0.999) << "}" << endl;
+}
+
+static bool parse(load_config& config, const string& argument) {
+	auto split = argument.find('=');
+	if (argument.compare(0, 2, "--") != 0 || split == string::npos)
+		return false;
+
+	auto key = argument.substr(2, split - 2);
+	auto value = argument.substr(split + 1);
+
+	if (key == "address") config.address = value;
+	else if (key == "base-port") config.base_port = stoul(value);
+	else if (key == "areas") config.areas = stoul(value);
+	else if (key == "brokers") config.brokers = stoul(value);
+	else if (key == "node-workers") config.node_workers = stoul(value);
+	else if (key == "client-workers") config.client_workers = stoul(value);
+	else if (key == "clients") config.clients = stoul(value);
+	else if (key == "depth") config.depth = stoul(value);
+	else if (key == "seconds") config.seconds = stoul(value);
+	else if (key == "cache-weight") config.cache_weight = stoul(value);
+	else if (key == "db-weight") config.db_weight = stoul(value);
+	else if (key == "relay-weight") config.relay_weight = stoul(value);
+	else if (key == "payload") config.payload = stoul(value);
+	else if (key == "db-latency-us") stub_context::statement_latency = chrono::microseconds(stoul(value));
+	else if (key == "work-us") handler_work = chrono::microseconds(stoul(value));
+	else return false;
+
+	return true;
+}
+
+static void start_nodes(const load_config& config, vector<unique_ptr<broker_node>>& brokers) {
+	auto creator = [](word) { return unique_ptr<stub_context>(new stub_context()); };
+	word count = max<word>(config.areas, 1);
+	vector<endpoint> broker_eps;
+
+	if (config.areas != 0) {
+		for (word i = 0; i < max<word>(config.brokers, 1); i++)
+			broker_eps.emplace_back(config.address, to_string(config.base_port + 100 + i));
+
+		for (word i = 0; i < broker_eps.size(); i++) {
+			auto broker = unique_ptr<broker_node>(new broker_node(config.node_workers, broker_eps[i]));
+
+			broker->set_peers(broker_eps, i);
+			brokers.push_back(move(broker));
+		}
+
+		for (auto& i : brokers)
+			i->start();
+	}
+
+	for (word i = 0; i < count; i++) {
+		auto node = unique_ptr<load_node>(new load_node(creator, config.node_workers, vector<endpoint> { endpoint(config.address, to_string(config.base_port + i)) }, broker_eps, config.areas != 0 ? i + 1 : 0));
+
+		node->register_handler<login_handler>(login_category, 0x00, false, load_node::transaction_mode::none);
+		node->register_handler<cache_handler>(work_category, 0x00, true, load_node::transaction_mode::none);
+		node->register_handler<db_handler>(work_category, 0x01, true, load_node::transaction_mode::read_write);
+		node->register_handler<relay_handler>(relay_category, 0x00, true, load_node::transaction_mode::none);
+		node->register_handler<relay_sink_handler>(relay_category, 0x01, true, load_node::transaction_mode::none);
+		node->enable_pipelining(true);
+		node->start();
+
+		nodes.push_back(move(node));
+	}
+}
+
+int main(int argc, char** argv) {
+	load_config config;
+
+	for (int i = 1; i < argc; i++) {
+		if (!parse(config, argv[i])) {
+			cerr << "usage: " << argv[0] << " [--address=A] [--base-port=N] [--areas=N] [--brokers=N] [--node-workers=N] [--client-workers=N] [--clients=N] [--depth=N] [--seconds=N] [--cache-weight=N] [--db-weight=N] [--relay-weight=N] [--payload=N] [--db-latency-us=N] [--work-us=N]" << endl;
+			return 1;
+		}
+	}
+
+	if (config.clients > max_clients) {
+		cerr << "--clients must not exceed " << max_clients << endl;
+		return 1;
+	}
+
+	vector<unique_ptr<broker_node>> brokers;
+	start_nodes(config, brokers);
+
+	request_server clients_server(vector<endpoint>(), config.client_workers, result_codes::retry_later);
+	vector<unique_ptr<client_state>> clients;
+	latency_log log;
+
+	log.notifications = 0;
+	log.failures = 0;
+
+	clients_server.on_request += [&clients, &log](shared_ptr<tcp_connection> connection, word worker_num, uint8 category, uint8 method, data_stream& parameters, data_stream& response) {
+		auto now = chrono::steady_clock::now();
+
+		if (category == relay_category && method == 0x01) {
+			log.notifications++;
+			return request_server::request_result::no_response;
+		}
+
+		try {
+			auto tag = parameters.read<uint32>();
+			auto result = parameters.read<result_code>();
+
+			if ((tag >> sequence_bits) >= clients.size()) {
+				log.failures++;
+				return request_server::request_result::no_response;
+			}
+
+			auto& client = *clients[tag >> sequence_bits];
+			auto latency = chrono::duration_cast<chrono::microseconds>(now - client.sent_at(tag & ((1 << sequence_bits) - 1))).count();
+
+			if (result != result_codes::success)
+				log.failures++;
+
+			client.in_flight--;
+
+			unique_lock<mutex> lck(log.lock);
+			log.samples[(category << 8) | method].push_back(latency);
+		}
+		catch (data_stream::read_past_end_exception&) {
+			log.failures++;
+		}
+
+		return request_server::request_result::no_response;
+	};
+
+	for (word i = 0; i < config.clients; i++)
+		clients.emplace_back(new client_state(max<word>(config.depth * 2, 16)));
+
+	clients_server.start();
+
+	for (word i = 0; i < clients.size(); i++) {
+		auto& client = *clients[i];
+		auto node_index = i % max<word>(config.areas, 1);
+
+		client.connection = clients_server.adopt(tcp_connection(endpoint(config.address, to_string(config.base_port + node_index))));
+		client.in_flight = 1;
+
+		data_stream message;
+		request_server::message::write_header(message, 0x00, login_category, 0x00);
+		message.write(static_cast<uint32>(i << sequence_bits));
+		message.write(static_cast<obj_id>(first_user_id + i));
+
+		client.mark_sent(0, chrono::steady_clock::now());
+		client.next_sequence = 1;
+
+		clients_server.enqueue_outgoing(request_server::message(client.connection, move(message)));
+	}
+
+	mt19937_64 generator(1);
+	word total_weight = max<word>(config.cache_weight + config.db_weight + config.relay_weight, 1);
+	auto deadline = chrono::steady_clock::now() + chrono::seconds(config.seconds);
+
+	while (chrono::steady_clock::now() < deadline) {
+		bool sent = false;
+
+		for (word i = 0; i < clients.size(); i++) {
+			auto& client = *clients[i];
+
+			if (client.in_flight >= config.depth)
+				continue;
+
+			data_stream message;
+			word pick = generator() % total_weight;
+			uint32 tag = static_cast<uint32>(i << sequence_bits) | (client.next_sequence & ((1 << sequence_bits) - 1));
+
+			if (pick < config.cache_weight) {
+				request_server::message::write_header(message, 0x00, work_category, 0x00);
+				message.write(tag);
+				message.write(static_cast<uint32>(config.payload));
+			}
+			else if (pick < config.cache_weight + config.db_weight) {
+				request_server::message::write_header(message, 0x00, work_category, 0x01);
+				message.write(tag);
+			}
+			else {
+				request_server::message::write_header(message, 0x00, relay_category, 0x00);
+				message.write(tag);
+				message.write(static_cast<obj_id>(config.areas != 0 ? first_user_id + generator() % clients.size() : 0));
+			}
+
+			client.mark_sent(client.next_sequence, chrono::steady_clock::now());
+			client.next_sequence++;
+			client.in_flight++;
+
+			clients_server.enqueue_outgoing(request_server::message(client.connection, move(message)));
+			sent = true;
+		}
+
+		if (!sent)
+			this_thread::sleep_for(chrono::microseconds(50));
+	}
+
+	unique_lock<mutex> lck(log.lock);
+
+	for (auto& i : log.samples) {
+		auto name = i.first == ((login_category << 8) | 0x00) ? "login" : i.first == ((work_category << 8) | 0x00) ? "cache" : i.first == ((work_category << 8) | 0x01) ? "db" : "relay";
+		report(name, i.second, config.seconds);
+	}
+
+	cout << "{\"notifications\":" << log.notifications << ",\"failures\":" << log.failures << "}" << endl;
+
+	return 0;
+}
@@ -0,0 +1,208 @@
+#include "LocalChannel.h"
+
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace game_server;
+
+local_channel::local_channel() {
+	this->control = nullptr;
+	this->buffer = nullptr;
+	this->capacity = 0;
+	this->mapped_size = 0;
+	this->owner = false;
+	this->handle = nullptr;
+}
+
+local_channel::~local_channel() {
+	if (!this->control)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(this->control);
+	CloseHandle(this->handle);
+#else
+	munmap(this->control, this->mapped_size);
+
+	if (this->owner)
+		shm_unlink(this->name.c_str());
+#endif
+}
+
+unique_ptr<local_channel> local_channel::create(const string& name, word capacity) {
+	unique_ptr<local_channel> channel(new local_channel());
+	word size = sizeof(control_block) + capacity;
+
+	channel->name = name;
+	channel->owner = true;
+
+#ifdef _WIN32
+	channel->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), name.c_str());
+	if (!channel->handle)
+		return nullptr;
+
+	void* memory = MapViewOfFile(channel->handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!memory)
+		return nullptr;
+#else
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd == -1)
+		return nullptr;
+
+	if (ftruncate(fd, size) == -1) {
+		close(fd);
+		shm_unlink(name.c_str());
+		return nullptr;
+	}
+
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		return nullptr;
+	}
+#endif
+
+	channel->control = new (memory) control_block();
+	channel->control->head = 0;
+	channel->control->tail = 0;
+	channel->control->attached = 0;
+	channel->control->capacity = capacity;
+	channel->buffer = reinterpret_cast<uint8*>(memory) + sizeof(control_block);
+	channel->capacity = capacity;
+	channel->mapped_size = size;
+
+	return channel;
+}
+
+unique_ptr<local_channel> local_channel::open(const string& name) {
+	unique_ptr<local_channel> channel(new local_channel());
+
+	channel->name = name;
+
+#ifdef _WIN32
+	channel->handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+	if (!channel->handle)
+		return nullptr;
+
+	void* memory = MapViewOfFile(channel->handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (!memory)
+		return nullptr;
+
+	MEMORY_BASIC_INFORMATION info;
+	VirtualQuery(memory, &info, sizeof(info));
+	word size = info.RegionSize;
+#else
+	int fd = shm_open(name.c_str(), O_RDWR, 0600);
+	if (fd == -1)
+		return nullptr;
+
+	struct stat info;
+	if (fstat(fd, &info) == -1 || static_cast<word>(info.st_size) < sizeof(control_block)) {
+		close(fd);
+		return nullptr;
+	}
+
+	word size = static_cast<word>(info.st_size);
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED)
+		return nullptr;
+#endif
+
+	channel->control = reinterpret_cast<control_block*>(memory);
+	channel->buffer = reinterpret_cast<uint8*>(memory) + sizeof(control_block);
+	channel->capacity = static_cast<word>(channel->control->capacity);
+	channel->mapped_size = size;
+
+	if (size < sizeof(control_block) || channel->capacity == 0 || channel->capacity > size - sizeof(control_block))
+		return nullptr;
+
+	return channel;
+}
+
+void local_channel::copy_in(uint64 position, const uint8* data, word length) {
+	word offset = position % this->capacity;
+	word first = min(length, this->capacity - offset);
+
+	memcpy(this->buffer + offset, data, first);
+	memcpy(this->buffer, data + first, length - first);
+}
+
+void local_channel::copy_out(uint64 position, uint8* data, word length) {
+	word offset = position % this->capacity;
+	word first = min(length, this->capacity - offset);
+
+	memcpy(data, this->buffer + offset, first);
+	memcpy(data + first, this->buffer, length - first);
+}
+
+bool local_channel::write(const uint8* data, word length) {
+	uint64 tail = this->control->tail.load(memory_order_relaxed);
+	uint64 head = this->control->head.load(memory_order_acquire);
+	uint32 frame_length = static_cast<uint32>(length);
+
+	if (this->capacity - (tail - head) < sizeof(frame_length) + length)
+		return false;
+
+	this->copy_in(tail, reinterpret_cast<const uint8*>(&frame_length), sizeof(frame_length));
+	this->copy_in(tail + sizeof(frame_length), data, length);
+
+	this->control->tail.store(tail + sizeof(frame_length) + length, memory_order_release);
+
+	return true;
+}
+
+bool local_channel::read(vector<uint8>& frame) {
+	uint64 head = this->control->head.load(memory_order_relaxed);
+	uint64 tail = this->control->tail.load(memory_order_acquire);
+	uint32 frame_length;
+
+	if (head == tail || tail - head > this->capacity || tail - head < sizeof(frame_length))
+		return false;
+
+	this->copy_out(head, reinterpret_cast<uint8*>(&frame_length), sizeof(frame_length));
+
+	if (frame_length > tail - head - sizeof(frame_length))
+		return false;
+
+	frame.resize(frame_length);
+	this->copy_out(head + sizeof(frame_length), frame.data(), frame_length);
+
+	this->control->head.store(head + sizeof(frame_length) + frame_length, memory_order_release);
+
+	return true;
+}
+
+bool local_channel::fits(word length) const {
+	return sizeof(uint32) + length <= this->capacity;
+}
+
+bool local_channel::is_empty() const {
+	return this->control->head.load(memory_order_acquire) == this->control->tail.load(memory_order_acquire);
+}
+
+void local_channel::set_attached() {
+	this->control->attached.store(1, memory_order_release);
+}
+
+bool local_channel::is_attached() const {
+	return this->control->attached.load(memory_order_acquire) != 0;
+}
+
+const string& local_channel::get_name() const {
+	return this->name;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+
+#include "Common.h"
+
+namespace game_server {
+	class local_channel {
+		struct control_block {
+			std::atomic<uint64> head;
+			uint8 head_padding[56];
+			std::atomic<uint64> tail;
+			uint8 tail_padding[56];
+			std::atomic<uint32> attached;
+			uint64 capacity;
+		};
+
+		std::string name;
+		control_block* control;
+		uint8* buffer;
+		word capacity;
+		word mapped_size;
+		bool owner;
+		void* handle;
+
+		local_channel();
+
+		void copy_in(uint64 position, const uint8* data, word length);
+		void copy_out(uint64 position, uint8* data, word length);
+
+		public:
+			local_channel(const local_channel& other) = delete;
+			local_channel(local_channel&& other) = delete;
+			local_channel& operator=(local_channel&& other) = delete;
+			local_channel& operator=(const local_channel& other) = delete;
+
+			~local_channel();
+
+			static std::unique_ptr<local_channel> create(const std::string& name, word capacity);
+			static std::unique_ptr<local_channel> open(const std::string& name);
+
+			bool write(const uint8* data, word length);
+			bool fits(word length) const;
+			bool is_empty() const;
+			bool read(std::vector<uint8>& frame);
+
+			void set_attached();
+			bool is_attached() const;
+			const std::string& get_name() const;
+	};
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <type_traits>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+#include <ArkeIndustries.CPPUtilities/DataStream.h>
+
+#include "Common.h"
+
+namespace game_server {
+	namespace schema {
+		inline void require(const uint8* cursor, const uint8* end, word count) {
+			if (static_cast<word>(end - cursor) < count)
+				throw util::data_stream::read_past_end_exception();
+		}
+
+		struct buffer_view {
+			const uint8* data;
+			uint16 length;
+
+			std::string str() const {
+				return std::string(reinterpret_cast<const char*>(this->data), this->length);
+			}
+		};
+
+		template<typename T> struct array_view {
+			static_assert(std::is_arithmetic<T>::value, "typename T must be arithmetic.");
+
+			const uint8* data;
+			uint16 count;
+
+			T operator[](word index) const {
+				T result;
+				std::memcpy(&result, this->data + index * sizeof(T), sizeof(T));
+				return result;
+			}
+
+			word size() const {
+				return this->count;
+			}
+		};
+
+		template<typename C, typename T, T C::*M> struct value {
+			static_assert(std::is_arithmetic<T>::value, "typename T must be arithmetic.");
+
+			static const word fixed_size = sizeof(T);
+
+			static void read(C& target, const uint8*& cursor, const uint8* end, word trailing) {
+				require(cursor, end, sizeof(T) + trailing);
+
+				std::memcpy(&(target.*M), cursor, sizeof(T));
+				cursor += sizeof(T);
+			}
+
+			static void write(const C& source, util::data_stream& stream) {
+				stream.write(source.*M);
+			}
+		};
+
+		template<typename C, buffer_view C::*M> struct bytes {
+			static const word fixed_size = sizeof(uint16);
+
+			static void read(C& target, const uint8*& cursor, const uint8* end, word trailing) {
+				auto& view = target.*M;
+
+				require(cursor, end, sizeof(uint16) + trailing);
+
+				std::memcpy(&view.length, cursor, sizeof(uint16));
+				cursor += sizeof(uint16);
+
+				require(cursor, end, view.length + trailing);
+
+				view.data = cursor;
+				cursor += view.length;
+			}
+
+			static void write(const C& source, util::data_stream& stream) {
+				auto& view = source.*M;
+
+				stream.write(view.length);
+				stream.write(view.data, view.length);
+			}
+		};
+
+		template<typename C, std::string C::*M> struct text {
+			static const word fixed_size = sizeof(uint16);
+
+			static void read(C& target, const uint8*& cursor, const uint8* end, word trailing) {
+				uint16 length;
+
+				require(cursor, end, sizeof(uint16) + trailing);
+
+				std::memcpy(&length, cursor, sizeof(uint16));
+				cursor += sizeof(uint16);
+
+				require(cursor, end, length + trailing);
+
+				(target.*M).assign(reinterpret_cast<const char*>(cursor), length);
+				cursor += length;
+			}
+
+			static void write(const C& source, util::data_stream& stream) {
+				auto& str = source.*M;
+
+				stream.write(static_cast<uint16>(str.size()));
+				stream.write(reinterpret_cast<const uint8*>(str.data()), str.size());
+			}
+		};
+
+		template<typename C, typename T, array_view<T> C::*M> struct list {
+			static const word fixed_size = sizeof(uint16);
+
+			static void read(C& target, const uint8*& cursor, const uint8* end, word trailing) {
+				auto& view = target.*M;
+
+				require(cursor, end, sizeof(uint16) + trailing);
+
+				std::memcpy(&view.count, cursor, sizeof(uint16));
+				cursor += sizeof(uint16);
+
+				require(cursor, end, view.count * sizeof(T) + trailing);
+
+				view.data = cursor;
+				cursor += view.count * sizeof(T);
+			}
+
+			static void write(const C& source, util::data_stream& stream) {
+				auto& view = source.*M;
+
+				stream.write(view.count);
+				stream.write(view.data, view.count * sizeof(T));
+			}
+		};
+
+		template<typename C, typename... Fields> struct message;
+
+		template<typename C> struct message<C> {
+			static const word fixed_size = 0;
+
+			static void read_fields(C& target, const uint8*& cursor, const uint8* end, word trailing) {
+
+			}
+
+			static void write_fields(const C& source, util::data_stream& stream) {
+
+			}
+		};
+
+		template<typename C, typename F, typename... Rest> struct message<C, F, Rest...> {
+			static const word fixed_size = F::fixed_size + message<C, Rest...>::fixed_size;
+
+			static void read_fields(C& target, const uint8*& cursor, const uint8* end, word trailing) {
+				F::read(target, cursor, end, message<C, Rest...>::fixed_size + trailing);
+				message<C, Rest...>::read_fields(target, cursor, end, trailing);
+			}
+
+			static void write_fields(const C& source, util::data_stream& stream) {
+				F::write(source, stream);
+				message<C, Rest...>::write_fields(source, stream);
+			}
+		};
+
+		template<typename C, typename... Fields> struct codec {
+			typedef message<C, Fields...> fields;
+
+			static void read(C& target, util::data_stream& stream) {
+				auto start = stream.data() + stream.position();
+				auto end = stream.data() + stream.size();
+				auto cursor = start;
+
+				if (static_cast<word>(end - start) < fields::fixed_size)
+					throw util::data_stream::read_past_end_exception();
+
+				fields::read_fields(target, cursor, end, 0);
+
+				stream.seek(stream.position() + static_cast<word>(cursor - start));
+			}
+
+			static void write(const C& source, util::data_stream& stream) {
+				fields::write_fields(source, stream);
+			}
+		};
+	}
+
+	template<typename Base, typename Derived> class schema_handler : public Base {
+		public:
+			virtual ~schema_handler() = default;
+
+			virtual void deserialize(util::data_stream& parameters) override {
+				Derived::request_schema::read(static_cast<Derived&>(*this), parameters);
+			}
+
+			virtual void serialize(util::data_stream& response) override {
+				Derived::response_schema::write(static_cast<const Derived&>(*this), response);
+			}
+	};
+}
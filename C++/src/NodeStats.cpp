@@ -0,0 +1,64 @@
+#include "NodeStats.h"
+
+using namespace std;
+using namespace util;
+using namespace game_server;
+
+const word latency_histogram::bucket_count;
+const word handler_stats::stage_count;
+const word handler_stats::result_count;
+
+latency_histogram::latency_histogram() {
+	for (auto& i : this->buckets)
+		i = 0;
+}
+
+void latency_histogram::record(chrono::microseconds elapsed) {
+	auto value = elapsed.count();
+	word bucket = 0;
+
+	while (value > 0 && bucket < latency_histogram::bucket_count - 1) {
+		value >>= 1;
+		bucket++;
+	}
+
+	this->buckets[bucket].fetch_add(1, memory_order_relaxed);
+}
+
+void latency_histogram::merge_into(array<uint64, latency_histogram::bucket_count>& totals) const {
+	for (word i = 0; i < latency_histogram::bucket_count; i++)
+		totals[i] += this->buckets[i].load(memory_order_relaxed);
+}
+
+handler_stats::handler_stats() {
+	this->requests = 0;
+
+	for (auto& i : this->results)
+		i = 0;
+}
+
+chrono::steady_clock::time_point handler_stats::record(stage which, chrono::steady_clock::time_point since) {
+	auto now = chrono::steady_clock::now();
+
+	this->stages[static_cast<word>(which)].record(chrono::duration_cast<chrono::microseconds>(now - since));
+
+	return now;
+}
+
+void handler_stats::record_result(result_code result) {
+	this->requests.fetch_add(1, memory_order_relaxed);
+	this->results[result < handler_stats::result_count ? result : handler_stats::result_count - 1].fetch_add(1, memory_order_relaxed);
+}
+
+uint64 handler_stats::get_requests() const {
+	return this->requests.load(memory_order_relaxed);
+}
+
+void handler_stats::merge_results_into(array<uint64, handler_stats::result_count>& totals) const {
+	for (word i = 0; i < handler_stats::result_count; i++)
+		totals[i] += this->results[i].load(memory_order_relaxed);
+}
+
+void handler_stats::merge_stage_into(stage which, array<uint64, latency_histogram::bucket_count>& totals) const {
+	this->stages[static_cast<word>(which)].merge_into(totals);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+#include <ArkeIndustries.CPPUtilities/DataStream.h>
+
+#include "Common.h"
+
+namespace game_server {
+	class latency_histogram {
+		public:
+			static const word bucket_count = 24;
+
+		private:
+			std::array<std::atomic<uint64>, bucket_count> buckets;
+
+		public:
+			latency_histogram(const latency_histogram& other) = delete;
+			latency_histogram(latency_histogram&& other) = delete;
+			latency_histogram& operator=(latency_histogram&& other) = delete;
+			latency_histogram& operator=(const latency_histogram& other) = delete;
+
+			latency_histogram();
+			~latency_histogram() = default;
+
+			void record(std::chrono::microseconds elapsed);
+			void merge_into(std::array<uint64, bucket_count>& totals) const;
+	};
+
+	class handler_stats {
+		public:
+			enum class stage {
+				deserialize,
+				process,
+				commit,
+				serialize
+			};
+
+			static const word stage_count = 4;
+			static const word result_count = 32;
+
+		private:
+			std::atomic<uint64> requests;
+			std::array<std::atomic<uint64>, result_count> results;
+			std::array<latency_histogram, stage_count> stages;
+
+		public:
+			handler_stats(const handler_stats& other) = delete;
+			handler_stats(handler_stats&& other) = delete;
+			handler_stats& operator=(handler_stats&& other) = delete;
+			handler_stats& operator=(const handler_stats& other) = delete;
+
+			handler_stats();
+			~handler_stats() = default;
+
+			std::chrono::steady_clock::time_point record(stage which, std::chrono::steady_clock::time_point since);
+			void record_result(result_code result);
+
+			uint64 get_requests() const;
+			void merge_results_into(std::array<uint64, result_count>& totals) const;
+			void merge_stage_into(stage which, std::array<uint64, latency_histogram::bucket_count>& totals) const;
+	};
+}
@@ -0,0 +1,148 @@
+#include "Placement.h"
+
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace std;
+using namespace game_server;
+
+cpu_set::cpu_set(vector<word> cpus) : cpus(cpus) {
+
+}
+
+cpu_set cpu_set::parse(const string& list) {
+	vector<word> cpus;
+	stringstream stream(list);
+	string range;
+
+	while (getline(stream, range, ',')) {
+		if (range.empty())
+			continue;
+
+		auto split = range.find('-');
+		word first = stoul(range.substr(0, split));
+		word last = split == string::npos ? first : stoul(range.substr(split + 1));
+
+		for (word i = first; i <= last; i++)
+			cpus.push_back(i);
+	}
+
+	return cpu_set(cpus);
+}
+
+cpu_set cpu_set::numa_node(word node) {
+	vector<word> cpus;
+
+	for (word i = 0; i < placement::cpu_count(); i++)
+		if (placement::numa_node_of(i) == node)
+			cpus.push_back(i);
+
+	return cpu_set(cpus);
+}
+
+bool cpu_set::empty() const {
+	return this->cpus.empty();
+}
+
+word cpu_set::size() const {
+	return this->cpus.size();
+}
+
+word cpu_set::cpu_for(word index) const {
+	return this->cpus[index % this->cpus.size()];
+}
+
+word placement::cpu_count() {
+	word count = thread::hardware_concurrency();
+
+	return count != 0 ? count : 1;
+}
+
+word placement::numa_node_of(word cpu) {
+#ifdef _WIN32
+	UCHAR node;
+
+	if (cpu < 256 && GetNumaProcessorNode(static_cast<UCHAR>(cpu), &node) && node != 0xFF)
+		return node;
+
+	return 0;
+#else
+	auto directory = opendir("/sys/devices/system/node");
+	word result = 0;
+	bool found = false;
+
+	if (!directory)
+		return 0;
+
+	while (!found) {
+		auto entry = readdir(directory);
+		if (!entry)
+			break;
+
+		string name(entry->d_name);
+		if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || name.find_first_not_of("0123456789", 4) != string::npos)
+			continue;
+
+		ifstream file("/sys/devices/system/node/" + name + "/cpulist");
+		string list;
+
+		if (!file || !getline(file, list))
+			continue;
+
+		auto cpus = cpu_set::parse(list);
+		for (word i = 0; i < cpus.size() && !found; i++) {
+			if (cpus.cpu_for(i) == cpu) {
+				result = stoul(name.substr(4));
+				found = true;
+			}
+		}
+	}
+
+	closedir(directory);
+
+	return result;
+#endif
+}
+
+bool placement::pin_current_thread(word cpu) {
+#ifdef _WIN32
+	return cpu < sizeof(DWORD_PTR) * 8 && SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+#elif defined(__linux__)
+	::cpu_set_t mask;
+
+	if (cpu >= CPU_SETSIZE)
+		return false;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+
+	return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+	return false;
+#endif
+}
+
+void placement::run_on(word cpu, const function<void()>& callback) {
+	thread worker([cpu, &callback]() {
+		placement::pin_current_thread(cpu);
+		callback();
+	});
+
+	worker.join();
+}
+
+void placement::report(const string& role, word index, word cpu) {
+	clog << role << " " << index << " placed on cpu " << cpu << " (numa node " << placement::numa_node_of(cpu) << ")" << endl;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+
+#include "Common.h"
+
+namespace game_server {
+	class cpu_set {
+		std::vector<word> cpus;
+
+		public:
+			cpu_set() = default;
+			cpu_set(std::vector<word> cpus);
+			~cpu_set() = default;
+
+			static cpu_set parse(const std::string& list);
+			static cpu_set numa_node(word node);
+
+			bool empty() const;
+			word size() const;
+			word cpu_for(word index) const;
+	};
+
+	class placement {
+		public:
+			static word cpu_count();
+			static word numa_node_of(word cpu);
+			static bool pin_current_thread(word cpu);
+			static void run_on(word cpu, const std::function<void()>& callback);
+			static void report(const std::string& role, word index, word cpu);
+	};
+}
@@ -1,18 +1,54 @@
 #include "ProcessorNode.h"
 
+#include <thread>
+
 using namespace std;
 using namespace util;
 using namespace util::net;
 using namespace game_server;
 
+const uint8 processor_node::stats_category;
+const uint8 processor_node::broker_batch_method;
+const uint8 processor_node::broker_attach_method;
+
 processor_node::processor_node(word workers, endpoint ep, endpoint broker_ep, obj_id area_id) : processor_node(workers, vector<endpoint> { ep }, broker_ep, area_id) {
 
 }
 
-processor_node::processor_node(word workers, vector<endpoint> eps, endpoint broker_ep, obj_id area_id) : server(eps, workers, result_codes::retry_later) {
+processor_node::processor_node(word workers, vector<endpoint> eps, endpoint broker_ep, obj_id area_id) : processor_node(workers, eps, vector<endpoint> { broker_ep }, area_id) {
+
+}
+
+processor_node::processor_node(word workers, vector<endpoint> eps, vector<endpoint> broker_eps, obj_id area_id) : server(eps, workers, result_codes::retry_later) {
 	this->workers = workers;
 	this->area_id = area_id;
-	this->broker_ep = broker_ep;
+	this->broker_eps = broker_eps;
+	this->broker_ring.reset(broker_eps.size());
+	this->broker_links.resize(broker_eps.size());
+	this->broker_attempts.assign(broker_eps.size(), 0);
+	this->broker_index = 0;
+	this->local_transport_enabled = true;
+	this->local_channel_capacity = 4 * 1024 * 1024;
+	this->broker_connect_attempts = 5;
+	this->broker_connect_backoff = chrono::milliseconds(200);
+	this->retry_attempts = 5;
+	this->retry_backoff = chrono::microseconds(50);
+	this->conflicts = 0;
+	this->retries_exhausted = 0;
+	this->stats_request_enabled = false;
+	this->busy_workers = 0;
+	this->requests_shed = 0;
+	this->max_in_flight = 0;
+	this->budgets_swept_size = 0;
+	this->session_locks_swept_size = 0;
+	this->requests_per_second = 0;
+	this->request_burst = 0;
+	this->reserved_workers = 0;
+	this->pipelining_enabled = false;
+
+	random_device seed;
+	for (word i = 0; i < workers; i++)
+		this->retry_generators.emplace_back(seed());
 
 	this->server.on_disconnect += std::bind(&processor_node::on_disconnect, this, std::placeholders::_1);
 	this->server.on_request += std::bind(&processor_node::on_request, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6);
@@ -23,13 +59,220 @@ processor_node::~processor_node() {
 }
 
 void processor_node::start() {
+	for (word i = 0; i < this->workers && !this->worker_cpus.empty(); i++) {
+		auto cpu = this->worker_cpus.cpu_for(i);
+
+		placement::run_on(cpu, [this, i]() { this->place_worker(i); });
+		placement::report("worker", i, cpu);
+	}
+
 	this->server.start();
 
-	if (this->area_id != 0) {
-		this->broker = this->server.adopt(tcp_connection(broker_ep));
-		this->broker->state = reinterpret_cast<void*>(this->area_id);
-		this->authenticated_clients[this->area_id].push_back(this->broker);
-		this->send_to_broker(this->area_id, this->create_message(0x00, 0x00));
+	if (this->area_id == 0)
+		return;
+
+	while (true) {
+		this->dial_brokers();
+
+		{
+			unique_lock<mutex> lck(this->broker_lock);
+
+			if (this->broker || this->broker_ring.size() == 0)
+				break;
+		}
+
+		this_thread::sleep_for(this->broker_connect_backoff);
+	}
+
+	this->broker_timer.reset(new timer<>(chrono::duration_cast<chrono::microseconds>(this->broker_connect_backoff)));
+	this->broker_timer->on_tick += bind(&processor_node::dial_brokers, this);
+}
+
+void processor_node::enable_local_transport(bool enabled, word capacity) {
+	this->local_transport_enabled = enabled;
+	this->local_channel_capacity = capacity;
+}
+
+void processor_node::set_broker_connect_policy(word attempts, chrono::milliseconds backoff) {
+	this->broker_connect_attempts = attempts;
+	this->broker_connect_backoff = backoff;
+}
+
+bool processor_node::connect_broker(word index) {
+	shared_ptr<tcp_connection> connection;
+
+	try {
+		connection = this->server.adopt(tcp_connection(this->broker_eps[index]));
+	}
+	catch (...) {
+		return false;
+	}
+
+	auto link = make_shared<local_link>();
+	link->connection = connection;
+	link->closed = false;
+
+	if (this->local_transport_enabled)
+		link->channel = local_channel::create("/game_server." + to_string(this->area_id) + "." + to_string(index + 1) + "." + to_string(random_device()()), this->local_channel_capacity);
+
+	unique_lock<mutex> link_lck(link->lock);
+
+	{
+		unique_lock<mutex> lck(this->clients_lock);
+
+		connection->state = reinterpret_cast<void*>(this->area_id);
+		this->authenticated_clients[this->area_id].push_back(connection);
+	}
+
+	{
+		unique_lock<mutex> lck(this->broker_lock);
+
+		this->broker_links[index] = link;
+		this->broker_attempts[index] = 0;
+		this->broker_ring.add(index);
+	}
+
+	auto message = this->create_message(0x00, processor_node::broker_attach_method);
+
+	if (link->channel) {
+		auto& name = link->channel->get_name();
+		message.write(static_cast<uint16>(name.size()));
+		message.write(reinterpret_cast<const uint8*>(name.data()), name.size());
+	}
+
+	message.write(this->area_id);
+	this->server.enqueue_outgoing(request_server::message(connection, std::move(message)));
+
+	auto deadline = chrono::steady_clock::now() + chrono::seconds(1);
+
+	while (link->channel && !link->channel->is_attached() && chrono::steady_clock::now() < deadline)
+		this_thread::sleep_for(chrono::microseconds(100));
+
+	if (link->channel && !link->channel->is_attached())
+		link->channel.reset();
+
+	return true;
+}
+
+void processor_node::dial_brokers() {
+	for (word i = 0; i < this->broker_eps.size(); i++) {
+		{
+			unique_lock<mutex> lck(this->broker_lock);
+
+			if (this->broker_links[i])
+				continue;
+		}
+
+		if (this->connect_broker(i))
+			continue;
+
+		unique_lock<mutex> lck(this->broker_lock);
+
+		if (++this->broker_attempts[i] >= this->broker_connect_attempts)
+			this->broker_ring.remove(i);
+	}
+
+	this->register_owner();
+}
+
+void processor_node::register_owner() {
+	shared_ptr<tcp_connection> connection;
+
+	{
+		unique_lock<mutex> lck(this->broker_lock);
+
+		if (this->broker_ring.size() == 0)
+			return;
+
+		auto index = this->broker_ring.owner(this->area_id);
+		auto& link = this->broker_links[index];
+
+		if (!link || this->broker == link->connection)
+			return;
+
+		connection = link->connection;
+		this->broker = connection;
+		this->broker_index = index;
+	}
+
+	auto message = this->create_message(0x00, 0x00);
+	message.write(this->area_id);
+	this->server.enqueue_outgoing(request_server::message(connection, std::move(message)));
+}
+
+void processor_node::fail_over(shared_ptr<tcp_connection> client) {
+	shared_ptr<local_link> link;
+
+	{
+		unique_lock<mutex> lck(this->broker_lock);
+
+		for (word i = 0; i < this->broker_links.size() && !link; i++) {
+			if (this->broker_links[i] && this->broker_links[i]->connection == client) {
+				link = this->broker_links[i];
+				this->broker_links[i] = nullptr;
+				this->broker_ring.remove(i);
+			}
+		}
+
+		if (!link)
+			return;
+
+		if (this->broker == client)
+			this->broker = nullptr;
+	}
+
+	link->closed = true;
+
+	this->register_owner();
+}
+
+void processor_node::enqueue_to_broker(obj_id route_id, data_stream message) {
+	while (true) {
+		shared_ptr<local_link> link;
+
+		{
+			unique_lock<mutex> lck(this->broker_lock);
+
+			if (this->broker_ring.size() != 0)
+				link = this->broker_links[this->broker_ring.owner(route_id)];
+
+			if (!link && this->broker)
+				link = this->broker_links[this->broker_index];
+		}
+
+		if (!link)
+			throw broker_node_down_exception();
+
+		unique_lock<mutex> lck(link->lock);
+
+		if (link->closed)
+			continue;
+
+		if (link->channel) {
+			if (link->channel->fits(message.size())) {
+				bool written = false;
+
+				while (!link->closed && !(written = link->channel->write(message.data(), message.size())))
+					this_thread::sleep_for(chrono::microseconds(10));
+
+				if (written)
+					return;
+
+				continue;
+			}
+
+			while (!link->closed && !link->channel->is_empty())
+				this_thread::sleep_for(chrono::microseconds(10));
+
+			if (link->closed)
+				continue;
+
+			link->channel.reset();
+		}
+
+		this->server.enqueue_outgoing(request_server::message(link->connection, std::move(message)));
+
+		return;
 	}
 }
 
@@ -47,11 +290,10 @@ void processor_node::del_client(obj_id id, shared_ptr<tcp_connection> conn) {
 	if (id == 0)
 		return;
 
-	if (id == this->area_id)
-		throw broker_node_down_exception();
-
 	std::unique_lock<std::mutex> lck(this->clients_lock);
 
+	conn->state = nullptr;
+
 	auto i = this->authenticated_clients.find(id);
 	if (i != this->authenticated_clients.end()) {
 		auto& list = i->second;
@@ -75,7 +317,41 @@ void processor_node::send(obj_id receipient_id, data_stream notification) {
 
 void processor_node::send_to_broker(obj_id target_id, data_stream message) {
 	message.write(target_id);
-	this->server.enqueue_outgoing(request_server::message(this->broker, std::move(message)));
+	this->enqueue_to_broker(target_id, std::move(message));
+}
+
+void processor_node::send_to_broker(const vector<obj_id>& target_ids, data_stream message) {
+	map<word, vector<obj_id>> shards;
+
+	{
+		unique_lock<mutex> lck(this->broker_lock);
+
+		for (auto id : target_ids)
+			shards[this->broker_ring.size() != 0 ? this->broker_ring.owner(id) : 0].push_back(id);
+	}
+
+	word remaining = shards.size();
+
+	for (auto& i : shards) {
+		data_stream shard = --remaining == 0 ? std::move(message) : data_stream(message);
+
+		for (auto id : i.second)
+			shard.write(id);
+
+		shard.write(static_cast<uint16>(i.second.size()));
+		shard.write(static_cast<obj_id>(0));
+		this->enqueue_to_broker(i.second.front(), std::move(shard));
+	}
+}
+
+bool processor_node::is_broker(tcp_connection* client) const {
+	unique_lock<mutex> lck(this->broker_lock);
+
+	for (auto& i : this->broker_links)
+		if (i && i->connection.get() == client)
+			return true;
+
+	return false;
 }
 
 data_stream processor_node::create_message(uint8 category, uint8 type) {
@@ -84,19 +360,390 @@ data_stream processor_node::create_message(uint8 category, uint8 type) {
 	return notification;
 }
 
+void processor_node::set_retry_policy(word attempts, chrono::microseconds backoff) {
+	this->retry_attempts = attempts;
+	this->retry_backoff = backoff;
+}
+
+uint64 processor_node::get_conflict_count() const {
+	return this->conflicts;
+}
+
+uint64 processor_node::get_retries_exhausted_count() const {
+	return this->retries_exhausted;
+}
+
+void processor_node::set_control_handler(uint8 method, function<void(data_stream&)> handler) {
+	this->control_handlers[method] = handler;
+}
+
+bool processor_node::dispatch_control(tcp_connection* client, uint8 category, uint8 method, data_stream& parameters) {
+	if (category != 0x00 || !this->is_broker(client))
+		return false;
+
+	auto iter = this->control_handlers.find(method);
+	if (iter == this->control_handlers.end())
+		return false;
+
+	try {
+		iter->second(parameters);
+	}
+	catch (data_stream::read_past_end_exception&) {
+
+	}
+
+	return true;
+}
+
+bool processor_node::dispatch_broker_batch(shared_ptr<tcp_connection> client, word worker_num, uint8 category, uint8 method, data_stream& parameters) {
+	if (category != 0x00 || method != processor_node::broker_batch_method || !this->is_broker(client.get()))
+		return false;
+
+	try {
+		while (parameters.position() < parameters.size()) {
+			auto inner_category = parameters.read<uint8>();
+			auto inner_method = parameters.read<uint8>();
+			auto length = parameters.read<uint32>();
+
+			if (parameters.size() - parameters.position() < length)
+				break;
+
+			data_stream inner;
+			data_stream scratch;
+
+			inner.write(parameters.data() + parameters.position(), length);
+			inner.seek(0);
+			parameters.seek(parameters.position() + length);
+
+			this->on_request(client, worker_num, inner_category, inner_method, inner, scratch);
+		}
+	}
+	catch (data_stream::read_past_end_exception&) {
+
+	}
+
+	return true;
+}
+
+bool processor_node::wait_for_retry(word worker_num, word attempt) {
+	this->conflicts++;
+
+	if (attempt >= this->retry_attempts) {
+		this->retries_exhausted++;
+		return false;
+	}
+
+	auto ceiling = this->retry_backoff.count() << min<word>(attempt, 10);
+	if (ceiling > 0) {
+		uniform_int_distribution<int64> jitter(ceiling / 2, ceiling);
+		this_thread::sleep_for(chrono::microseconds(jitter(this->retry_generators[worker_num])));
+	}
+
+	return true;
+}
+
+handler_stats& processor_node::get_stats(uint16 type, word worker_num) {
+	return *this->stats.at(type)[worker_num];
+}
+
+void processor_node::set_worker_cpus(cpu_set cpus) {
+	this->worker_cpus = cpus;
+	this->workers_pinned.assign(this->workers, 0);
+}
+
+void processor_node::place_worker(word worker_num) {
+	for (auto& i : this->authenticated_factories)
+		this->authenticated_handlers[i.first][worker_num].reset(i.second());
+
+	for (auto& i : this->unauthenticated_factories)
+		this->unauthenticated_handlers[i.first][worker_num].reset(i.second());
+
+	for (auto& i : this->stats)
+		i.second[worker_num].reset(new handler_stats());
+}
+
+void processor_node::pin_worker(word worker_num) {
+	if (this->worker_cpus.empty() || this->workers_pinned[worker_num])
+		return;
+
+	placement::pin_current_thread(this->worker_cpus.cpu_for(worker_num));
+	this->workers_pinned[worker_num] = 1;
+}
+
+void processor_node::add_stats(uint16 type) {
+	auto& list = this->stats[type];
+
+	for (word i = list.size(); i < this->workers; i++)
+		list.emplace_back(new handler_stats());
+}
+
+void processor_node::set_client_limits(word max_in_flight, word requests_per_second, word burst) {
+	this->max_in_flight = max_in_flight;
+	this->requests_per_second = requests_per_second;
+	this->request_burst = max(burst, requests_per_second);
+}
+
+void processor_node::set_reserved_workers(word reserved) {
+	this->reserved_workers = min(reserved, this->workers);
+}
+
+void processor_node::set_handler_admission(uint8 category, uint8 method, word cost, bool priority) {
+	this->admission[(category << 8) | method] = handler_admission { cost, priority };
+}
+
+uint64 processor_node::get_requests_shed_count() const {
+	return this->requests_shed;
+}
+
+bool processor_node::admit(shared_ptr<tcp_connection> client, uint16 type) {
+	auto iter = this->admission.find(type);
+	word cost = iter != this->admission.end() ? iter->second.cost : 1;
+	bool priority = (iter != this->admission.end() && iter->second.priority) || this->is_broker(client.get());
+
+	if (!priority && this->reserved_workers != 0 && this->busy_workers >= this->workers - this->reserved_workers) {
+		this->requests_shed++;
+		return false;
+	}
+
+	if (this->max_in_flight != 0 || this->requests_per_second != 0) {
+		unique_lock<mutex> lck(this->budgets_lock);
+
+		auto now = chrono::steady_clock::now();
+		auto result = this->budgets.emplace(weak_ptr<tcp_connection>(client), client_budget { 0, static_cast<double>(this->request_burst), now });
+
+		if (result.second && this->budgets.size() >= 2 * this->budgets_swept_size + 64)
+			processor_node::sweep_expired(this->budgets, this->budgets_swept_size);
+		auto& budget = result.first->second;
+
+		if (this->requests_per_second != 0) {
+			budget.tokens += chrono::duration_cast<chrono::duration<double>>(now - budget.refilled).count() * this->requests_per_second;
+			budget.tokens = min(budget.tokens, static_cast<double>(this->request_burst));
+			budget.refilled = now;
+		}
+
+		if (!priority && ((this->max_in_flight != 0 && budget.in_flight >= this->max_in_flight) || (this->requests_per_second != 0 && budget.tokens < cost))) {
+			this->requests_shed++;
+			return false;
+		}
+
+		if (this->requests_per_second != 0)
+			budget.tokens -= cost;
+
+		budget.in_flight++;
+	}
+
+	this->busy_workers++;
+
+	return true;
+}
+
+void processor_node::release(shared_ptr<tcp_connection> client) {
+	this->release_worker();
+	this->release_budget(client);
+}
+
+void processor_node::release_worker() {
+	this->busy_workers--;
+}
+
+void processor_node::release_budget(shared_ptr<tcp_connection> client) {
+	if (this->max_in_flight != 0 || this->requests_per_second != 0) {
+		unique_lock<mutex> lck(this->budgets_lock);
+
+		auto iter = this->budgets.find(weak_ptr<tcp_connection>(client));
+		if (iter != this->budgets.end() && iter->second.in_flight > 0)
+			iter->second.in_flight--;
+	}
+}
+
+processor_node::admission_ticket::admission_ticket(processor_node& node, shared_ptr<tcp_connection> client, uint16 type) : node(node), client(client) {
+	this->admitted = node.admit(client, type);
+	this->deferred = false;
+}
+
+processor_node::admission_ticket::~admission_ticket() {
+	if (this->admitted && !this->deferred)
+		this->node.release(this->client);
+}
+
+void processor_node::admission_ticket::defer() {
+	if (!this->admitted || this->deferred)
+		return;
+
+	this->deferred = true;
+	this->node.release_worker();
+}
+
+processor_node::admission_ticket::operator bool() const {
+	return this->admitted;
+}
+
+void processor_node::enable_pipelining(bool enabled) {
+	this->pipelining_enabled = enabled;
+}
+
+void processor_node::set_handler_session_exclusive(uint8 category, uint8 method) {
+	this->session_exclusive_handlers.insert((category << 8) | method);
+}
+
+bool processor_node::read_request_tag(tcp_connection* client, data_stream& parameters, data_stream& response, uint32& tag) {
+	if (!this->pipelining_enabled || this->is_broker(client))
+		return true;
+
+	try {
+		tag = parameters.read<uint32>();
+	}
+	catch (data_stream::read_past_end_exception&) {
+		response.write(result_codes::invalid_parameters);
+		return false;
+	}
+
+	response.write(tag);
+
+	return true;
+}
+
+obj_id processor_node::get_client_id(tcp_connection* client) {
+	unique_lock<mutex> lck(this->clients_lock);
+
+	return reinterpret_cast<obj_id>(client->state);
+}
+
+processor_node::session_guard processor_node::lock_session(shared_ptr<tcp_connection> client, uint16 type) {
+	session_guard guard;
+
+	if (!this->pipelining_enabled || (this->get_client_id(client.get()) != 0 && this->session_exclusive_handlers.count(type) == 0))
+		return guard;
+
+	{
+		unique_lock<mutex> lck(this->session_locks_lock);
+
+		auto result = this->session_locks.emplace(weak_ptr<tcp_connection>(client), nullptr);
+		auto& mtx = result.first->second;
+		if (!mtx)
+			mtx = make_shared<mutex>();
+
+		if (result.second && this->session_locks.size() >= 2 * this->session_locks_swept_size + 64)
+			processor_node::sweep_expired(this->session_locks, this->session_locks_swept_size);
+
+		guard.mtx = mtx;
+	}
+
+	guard.lck = unique_lock<mutex>(*guard.mtx);
+
+	return guard;
+}
+
+void processor_node::enable_stats_request(bool enabled) {
+	this->stats_request_enabled = enabled;
+}
+
+void processor_node::add_stats_operator(obj_id id) {
+	unique_lock<mutex> lck(this->stats_operators_lock);
+
+	this->stats_operators.insert(id);
+}
+
+void processor_node::remove_stats_operator(obj_id id) {
+	unique_lock<mutex> lck(this->stats_operators_lock);
+
+	this->stats_operators.erase(id);
+}
+
+bool processor_node::serve_stats(obj_id authenticated_id, uint8 category, data_stream& response) {
+	if (category != processor_node::stats_category || !this->stats_request_enabled || authenticated_id == 0)
+		return false;
+
+	{
+		unique_lock<mutex> lck(this->stats_operators_lock);
+
+		if (this->stats_operators.count(authenticated_id) == 0)
+			return false;
+	}
+
+	response.write(result_codes::success);
+	this->write_stats(response);
+
+	return true;
+}
+
+void processor_node::write_stats(data_stream& stream) {
+	stream.write(static_cast<uint64>(this->conflicts));
+	stream.write(static_cast<uint64>(this->retries_exhausted));
+	stream.write(static_cast<uint64>(this->requests_shed));
+	stream.write(static_cast<uint16>(this->stats.size()));
+
+	for (auto& i : this->stats) {
+		uint64 requests = 0;
+		array<uint64, handler_stats::result_count> results {};
+
+		for (auto& j : i.second) {
+			requests += j->get_requests();
+			j->merge_results_into(results);
+		}
+
+		stream.write(i.first);
+		stream.write(requests);
+
+		for (auto j : results)
+			stream.write(j);
+
+		for (word stage = 0; stage < handler_stats::stage_count; stage++) {
+			array<uint64, latency_histogram::bucket_count> buckets {};
+
+			for (auto& j : i.second)
+				j->merge_stage_into(static_cast<handler_stats::stage>(stage), buckets);
+
+			for (auto j : buckets)
+				stream.write(j);
+		}
+	}
+}
+
 void processor_node::on_connect(shared_ptr<tcp_connection> client) {
 
 }
 
 void processor_node::on_disconnect(shared_ptr<tcp_connection> client) {
-	this->del_client(reinterpret_cast<obj_id>(client->state), client);
+	{
+		unique_lock<mutex> lck(this->budgets_lock);
+		this->budgets.erase(weak_ptr<tcp_connection>(client));
+	}
+
+	{
+		unique_lock<mutex> lck(this->session_locks_lock);
+		this->session_locks.erase(weak_ptr<tcp_connection>(client));
+	}
+
+	this->del_client(this->get_client_id(client.get()), client);
+
+	if (this->is_broker(client.get()))
+		this->fail_over(client);
 }
 
 request_server::request_result processor_node::on_request(shared_ptr<tcp_connection> client, word worker_num, uint8 category, uint8 method, data_stream& parameters, data_stream& response) {
+	this->pin_worker(worker_num);
+
 	result_code result = result_codes::success;
-	obj_id authenticated_id = reinterpret_cast<obj_id>(client->state);
-	obj_id start_id = authenticated_id;
 	uint16 type = (category << 8) | method;
+	uint32 tag = 0;
+
+	if (this->dispatch_broker_batch(client, worker_num, category, method, parameters) || this->dispatch_control(client.get(), category, method, parameters))
+		return request_server::request_result::no_response;
+
+	if (!this->read_request_tag(client.get(), parameters, response, tag))
+		return request_server::request_result::success;
+
+	admission_ticket ticket(*this, client, type);
+	if (!ticket)
+		return request_server::request_result::retry_later;
+
+	auto session = this->lock_session(client, type);
+	obj_id authenticated_id = this->get_client_id(client.get());
+	obj_id start_id = authenticated_id;
+
+	if (this->serve_stats(authenticated_id, category, response))
+		return request_server::request_result::success;
 
 	if ((authenticated_id != 0 && this->authenticated_handlers.count(type) == 0) || (authenticated_id == 0 && this->unauthenticated_handlers.count(type) == 0)) {
 		response.write(result_codes::invalid_request_type);
@@ -104,26 +751,46 @@ request_server::request_result processor_node::on_request(shared_ptr<tcp_connect
 	}
 
 	auto& handler = *reinterpret_cast<base_handler*>(authenticated_id != 0 ? this->authenticated_handlers[type][worker_num].get() : this->unauthenticated_handlers[type][worker_num].get());
+	auto parameters_start = parameters.position();
+	auto& stats = this->get_stats(type, worker_num);
+	auto mark = chrono::steady_clock::now();
 
-	try {
-		handler.deserialize(parameters);
-	}
-	catch (data_stream::read_past_end_exception&) {
-		response.write(result_codes::invalid_parameters);
-		return request_server::request_result::success;
-	}
+	for (word attempt = 0; ; attempt++) {
+		try {
+			handler.deserialize(parameters);
+		}
+		catch (data_stream::read_past_end_exception&) {
+			stats.record_result(result_codes::invalid_parameters);
+			response.write(result_codes::invalid_parameters);
+			return request_server::request_result::success;
+		}
 
-	try {
-		result = handler.process(authenticated_id);
-	}
-	catch (sql::synchronization_exception&) {
-		return request_server::request_result::retry_later;
+		mark = stats.record(handler_stats::stage::deserialize, mark);
+
+		try {
+			result = handler.process(authenticated_id);
+			mark = stats.record(handler_stats::stage::process, mark);
+			break;
+		}
+		catch (sql::synchronization_exception&) {
+			if (!this->wait_for_retry(worker_num, attempt)) {
+				stats.record_result(result_codes::retry_later);
+				return request_server::request_result::retry_later;
+			}
+
+			authenticated_id = start_id;
+			parameters.seek(parameters_start);
+			mark = chrono::steady_clock::now();
+		}
 	}
 
 	response.write(result);
+	stats.record_result(result);
 
-	if (result == result_codes::success)
+	if (result == result_codes::success) {
 		handler.serialize(response);
+		stats.record(handler_stats::stage::serialize, mark);
+	}
 	else if (result == result_codes::no_response)
 		return request_server::request_result::no_response;
 
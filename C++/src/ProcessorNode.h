@@ -1,21 +1,32 @@
 #pragma once
 
 #include <string>
+#include <map>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <vector>
 #include <functional>
 #include <algorithm>
 #include <type_traits>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <condition_variable>
 
 #include <ArkeIndustries.CPPUtilities/Common.h>
 #include <ArkeIndustries.CPPUtilities/Optional.h>
+#include <ArkeIndustries.CPPUtilities/Timer.h>
 #include <ArkeIndustries.CPPUtilities/SQL/Database.h>
 #include <ArkeIndustries.CPPUtilities/Net/RequestServer.h>
 #include <ArkeIndustries.CPPUtilities/Net/TCPConnection.h>
 
 #include "Common.h"
+#include "NodeStats.h"
+#include "HashRing.h"
+#include "LocalChannel.h"
+#include "Placement.h"
 
 namespace game_server {
 	class processor_node {
@@ -30,6 +41,30 @@ namespace game_server {
 
 			class broker_node_down_exception {};
 
+			static const uint8 stats_category = 0xFF;
+			static const uint8 broker_batch_method = 0x01;
+			static const uint8 broker_attach_method = 0x02;
+
+			class admission_ticket {
+				processor_node& node;
+				std::shared_ptr<util::net::tcp_connection> client;
+				bool admitted;
+				bool deferred;
+
+				public:
+					admission_ticket(const admission_ticket& other) = delete;
+					admission_ticket(admission_ticket&& other) = delete;
+					admission_ticket& operator=(admission_ticket&& other) = delete;
+					admission_ticket& operator=(const admission_ticket& other) = delete;
+
+					admission_ticket(processor_node& node, std::shared_ptr<util::net::tcp_connection> client, uint16 type);
+					~admission_ticket();
+
+					void defer();
+
+					explicit operator bool() const;
+			};
+
 			processor_node(const processor_node& other) = delete;
 			processor_node(processor_node&& other) = delete;
 			processor_node& operator=(processor_node&& other) = delete;
@@ -38,14 +73,123 @@ namespace game_server {
 		protected:
 			std::unordered_map<uint16, std::vector<std::unique_ptr<base_handler>>> authenticated_handlers;
 			std::unordered_map<uint16, std::vector<std::unique_ptr<base_handler>>> unauthenticated_handlers;
+			std::unordered_map<uint16, std::function<base_handler*()>> authenticated_factories;
+			std::unordered_map<uint16, std::function<base_handler*()>> unauthenticated_factories;
 			util::net::request_server server;
-			util::net::endpoint broker_ep;
+			std::vector<util::net::endpoint> broker_eps;
 			std::shared_ptr<util::net::tcp_connection> broker;
+			word broker_index;
+			hash_ring broker_ring;
+			mutable std::mutex broker_lock;
+
+			struct local_link {
+				std::shared_ptr<util::net::tcp_connection> connection;
+				std::unique_ptr<local_channel> channel;
+				std::atomic<bool> closed;
+				std::mutex lock;
+			};
+
+			std::vector<std::shared_ptr<local_link>> broker_links;
+			std::vector<word> broker_attempts;
+			std::unique_ptr<util::timer<>> broker_timer;
+			bool local_transport_enabled;
+			word local_channel_capacity;
+			word broker_connect_attempts;
+			std::chrono::milliseconds broker_connect_backoff;
+
+			bool connect_broker(word index);
+			void dial_brokers();
+			void register_owner();
+			void fail_over(std::shared_ptr<util::net::tcp_connection> client);
+			void enqueue_to_broker(obj_id route_id, util::data_stream message);
 			std::unordered_map<obj_id, std::vector<std::shared_ptr<util::net::tcp_connection>>> authenticated_clients;
 			std::mutex clients_lock;
 			obj_id area_id;
 			word workers;
 
+			word retry_attempts;
+			std::chrono::microseconds retry_backoff;
+			std::vector<std::minstd_rand> retry_generators;
+			std::atomic<uint64> conflicts;
+			std::atomic<uint64> retries_exhausted;
+
+			std::unordered_map<uint16, std::vector<std::unique_ptr<handler_stats>>> stats;
+			bool stats_request_enabled;
+			std::unordered_set<obj_id> stats_operators;
+			std::mutex stats_operators_lock;
+
+			bool serve_stats(obj_id authenticated_id, uint8 category, util::data_stream& response);
+
+			cpu_set worker_cpus;
+			std::vector<uint8> workers_pinned;
+
+			virtual void place_worker(word worker_num);
+			void pin_worker(word worker_num);
+
+			template<typename V> using connection_map = std::map<std::weak_ptr<util::net::tcp_connection>, V, std::owner_less<std::weak_ptr<util::net::tcp_connection>>>;
+
+			template<typename V> static void sweep_expired(connection_map<V>& map, word& swept_size) {
+				for (auto i = map.begin(); i != map.end(); ) {
+					if (i->first.expired())
+						i = map.erase(i);
+					else
+						++i;
+				}
+
+				swept_size = map.size();
+			}
+
+			struct client_budget {
+				word in_flight;
+				double tokens;
+				std::chrono::steady_clock::time_point refilled;
+			};
+
+			struct handler_admission {
+				word cost;
+				bool priority;
+			};
+
+			connection_map<client_budget> budgets;
+			word budgets_swept_size;
+			std::unordered_map<uint16, handler_admission> admission;
+			std::mutex budgets_lock;
+			std::atomic<word> busy_workers;
+			std::atomic<uint64> requests_shed;
+			word max_in_flight;
+			word requests_per_second;
+			word request_burst;
+			word reserved_workers;
+
+			bool admit(std::shared_ptr<util::net::tcp_connection> client, uint16 type);
+			void release(std::shared_ptr<util::net::tcp_connection> client);
+			void release_worker();
+			void release_budget(std::shared_ptr<util::net::tcp_connection> client);
+
+			struct session_guard {
+				std::shared_ptr<std::mutex> mtx;
+				std::unique_lock<std::mutex> lck;
+			};
+
+			bool pipelining_enabled;
+			std::unordered_set<uint16> session_exclusive_handlers;
+			connection_map<std::shared_ptr<std::mutex>> session_locks;
+			word session_locks_swept_size;
+			std::mutex session_locks_lock;
+
+			bool read_request_tag(util::net::tcp_connection* client, util::data_stream& parameters, util::data_stream& response, uint32& tag);
+			session_guard lock_session(std::shared_ptr<util::net::tcp_connection> client, uint16 type);
+			obj_id get_client_id(util::net::tcp_connection* client);
+
+			bool is_broker(util::net::tcp_connection* client) const;
+			std::unordered_map<uint8, std::function<void(util::data_stream&)>> control_handlers;
+
+			bool dispatch_control(util::net::tcp_connection* client, uint8 category, uint8 method, util::data_stream& parameters);
+			bool dispatch_broker_batch(std::shared_ptr<util::net::tcp_connection> client, word worker_num, uint8 category, uint8 method, util::data_stream& parameters);
+			bool wait_for_retry(word worker_num, word attempt);
+			handler_stats& get_stats(uint16 type, word worker_num);
+			void add_stats(uint16 type);
+
 			void add_client(obj_id id, std::shared_ptr<util::net::tcp_connection> conn);
 			void del_client(obj_id id, std::shared_ptr<util::net::tcp_connection> conn);
 
@@ -56,18 +200,45 @@ namespace game_server {
 		public:
 			processor_node(word workers, util::net::endpoint ep, util::net::endpoint broker_ep = util::net::endpoint(), obj_id area_id = 0);
 			processor_node(word workers, std::vector<util::net::endpoint> eps, util::net::endpoint broker_ep = util::net::endpoint(), obj_id area_id = 0);
+			processor_node(word workers, std::vector<util::net::endpoint> eps, std::vector<util::net::endpoint> broker_eps, obj_id area_id);
 			virtual ~processor_node();
 
-			void start();
+			virtual void start();
+			void enable_local_transport(bool enabled, word capacity = 4 * 1024 * 1024);
+			void set_broker_connect_policy(word attempts, std::chrono::milliseconds backoff);
+			void set_control_handler(uint8 method, std::function<void(util::data_stream&)> handler);
 			void send(obj_id receipient_id, util::data_stream notification);
 			void send_to_broker(obj_id target_id, util::data_stream message);
+			void send_to_broker(const std::vector<obj_id>& target_ids, util::data_stream message);
 			util::data_stream create_message(uint8 category, uint8 type);
 
+			void set_retry_policy(word attempts, std::chrono::microseconds backoff);
+			uint64 get_conflict_count() const;
+			uint64 get_retries_exhausted_count() const;
+
+			void set_client_limits(word max_in_flight, word requests_per_second, word burst);
+			void set_reserved_workers(word reserved);
+			void set_handler_admission(uint8 category, uint8 method, word cost, bool priority);
+			uint64 get_requests_shed_count() const;
+
+			void enable_pipelining(bool enabled);
+			void set_handler_session_exclusive(uint8 category, uint8 method);
+
+			void enable_stats_request(bool enabled);
+			void add_stats_operator(obj_id id);
+			void remove_stats_operator(obj_id id);
+			void set_worker_cpus(cpu_set cpus);
+			void write_stats(util::data_stream& stream);
+
 			template<typename T> void register_handler(uint8 category, uint8 method, bool authenticated) {
 				static_assert(std::is_base_of<base_handler, T>::value, "typename T must derive from base_handler.");
 
 				for (word i = 0; i < this->workers; i++)
 					(authenticated ? this->authenticated_handlers : this->unauthenticated_handlers)[(category << 8) | method].emplace_back(new T());
+
+				(authenticated ? this->authenticated_factories : this->unauthenticated_factories)[(category << 8) | method] = [] { return new T(); };
+
+				this->add_stats((category << 8) | method);
 			}
 	};
 
@@ -81,7 +252,25 @@ namespace game_server {
 					virtual result_code process(obj_id& user_id, T& db) = 0;
 			};
 
+			class deferred_handler : public processor_node::base_handler {
+				virtual result_code process(obj_id& user_id) override { return result_codes::success; };
+
+				public:
+					typedef std::function<void(result_code)> completion;
+
+					virtual ~deferred_handler() = default;
+					virtual void process(obj_id user_id, T& db, completion done) = 0;
+			};
+
+			enum class transaction_mode {
+				none,
+				read_only,
+				read_write,
+				group
+			};
+
 			typedef std::function<std::unique_ptr<T>(word)> context_creator;
+			typedef std::function<void(word, T&)> context_reset_handler;
 
 			processor_node_db(const processor_node_db& other) = delete;
 			processor_node_db(processor_node_db&& other) = delete;
@@ -89,22 +278,315 @@ namespace game_server {
 			processor_node_db& operator=(const processor_node_db& other) = delete;
 
 		protected:
+			struct transaction_options {
+				transaction_mode mode;
+				util::sql::connection::isolation_level level;
+			};
+
+			struct group_batch {
+				bool done;
+				bool failed;
+			};
+
+			struct group_commit {
+				std::mutex lock;
+				std::condition_variable committed;
+				std::unique_ptr<T> context;
+				std::shared_ptr<group_batch> current;
+				std::chrono::steady_clock::time_point opened;
+				util::sql::connection::isolation_level level;
+				std::chrono::microseconds max_delay;
+				word max_size;
+				word pending;
+			};
+
+			context_creator creator;
+			context_reset_handler on_context_reset;
 			std::vector<std::unique_ptr<T>> dbs;
+			std::unordered_map<uint16, transaction_options> transaction_modes;
+			std::unique_ptr<group_commit> group;
+			std::unordered_map<uint16, std::function<std::shared_ptr<deferred_handler>()>> authenticated_deferred_handlers;
+			std::unordered_map<uint16, std::function<std::shared_ptr<deferred_handler>()>> unauthenticated_deferred_handlers;
+			std::vector<std::unique_ptr<T>> deferred_contexts;
+			std::mutex deferred_contexts_lock;
+			word deferred_contexts_created;
+			word deferred_context_limit;
+
+			std::shared_ptr<T> acquire_deferred_context() {
+				std::unique_ptr<T> context;
+				word index = 0;
+
+				{
+					std::unique_lock<std::mutex> lck(this->deferred_contexts_lock);
+
+					if (!this->deferred_contexts.empty()) {
+						context = std::move(this->deferred_contexts.back());
+						this->deferred_contexts.pop_back();
+					}
+					else if (this->deferred_contexts_created < this->deferred_context_limit) {
+						index = this->workers + 1 + this->deferred_contexts_created++;
+					}
+					else {
+						return nullptr;
+					}
+				}
+
+				if (!context) {
+					try {
+						context = this->creator(index);
+					}
+					catch (...) {
+						std::unique_lock<std::mutex> lck(this->deferred_contexts_lock);
+						this->deferred_contexts_created--;
+						throw;
+					}
+				}
+
+				return std::shared_ptr<T>(context.release(), [this](T* released) {
+					std::unique_lock<std::mutex> lck(this->deferred_contexts_lock);
+					this->deferred_contexts.emplace_back(released);
+				});
+			}
+
+			util::net::request_server::request_result process_deferred(std::shared_ptr<util::net::tcp_connection> client, std::shared_ptr<deferred_handler> handler, obj_id authenticated_id, word worker_num, util::data_stream& parameters, util::data_stream& response, handler_stats& stats, processor_node::admission_ticket& ticket) {
+				auto context = this->acquire_deferred_context();
+				if (!context)
+					return util::net::request_server::request_result::retry_later;
+
+				auto parameters_start = parameters.position();
+				auto mark = std::chrono::steady_clock::now();
+				util::data_stream reply(response);
+				auto reply_start = reply.size();
+
+				for (word attempt = 0; ; attempt++) {
+					try {
+						handler->deserialize(parameters);
+					}
+					catch (util::data_stream::read_past_end_exception&) {
+						stats.record_result(result_codes::invalid_parameters);
+						response.write(result_codes::invalid_parameters);
+						return util::net::request_server::request_result::success;
+					}
+
+					mark = stats.record(handler_stats::stage::deserialize, mark);
+
+					try {
+						handler->process(authenticated_id, *context, [this, client, handler, context, reply, reply_start, &stats, mark](result_code result) mutable {
+							auto serialize_start = stats.record(handler_stats::stage::process, mark);
+
+							reply.write(result);
+
+							if (result == result_codes::success) {
+								try {
+									handler->serialize(reply);
+									stats.record(handler_stats::stage::serialize, serialize_start);
+								}
+								catch (...) {
+									result = result_codes::server_error;
+									reply.shrink_written(reply_start);
+									reply.write(result);
+								}
+							}
+
+							stats.record_result(result);
+
+							if (result != result_codes::no_response)
+								this->server.enqueue_outgoing(util::net::request_server::message(client, std::move(reply)));
+
+							this->release_budget(client);
+						});
+
+						ticket.defer();
+
+						return util::net::request_server::request_result::no_response;
+					}
+					catch (const util::sql::synchronization_exception&) {
+						if (!context->committed())
+							context->rollback_transaction();
+
+						if (!this->wait_for_retry(worker_num, attempt)) {
+							stats.record_result(result_codes::retry_later);
+							return util::net::request_server::request_result::retry_later;
+						}
+
+						parameters.seek(parameters_start);
+						mark = std::chrono::steady_clock::now();
+					}
+				}
+			}
+
+			template<typename U> static auto begin_read_only(U& context, util::sql::connection::isolation_level level, int) -> decltype(context.begin_transaction(level, true), void()) {
+				context.begin_transaction(level, true);
+			}
+
+			template<typename U> static void begin_read_only(U& context, util::sql::connection::isolation_level level, long) {
+				context.begin_transaction(level);
+			}
+
+			void flush_group(bool commit) {
+				auto& group = *this->group;
+				bool failed = !commit;
+
+				try {
+					if (commit)
+						group.context->commit_transaction();
+					else
+						group.context->rollback_transaction();
+				}
+				catch (...) {
+					failed = true;
+
+					try {
+						if (!group.context->committed())
+							group.context->rollback_transaction();
+					}
+					catch (...) {
+
+					}
+				}
+
+				group.current->done = true;
+				group.current->failed = failed;
+				group.current = std::make_shared<group_batch>(group_batch { false, false });
+				group.pending = 0;
+				group.committed.notify_all();
+			}
+
+			result_code process_grouped(base_handler& handler, obj_id& authenticated_id) {
+				auto& group = *this->group;
+				result_code result = result_codes::success;
+
+				std::unique_lock<std::mutex> lck(group.lock);
+
+				auto batch = group.current;
+
+				if (group.pending == 0) {
+					group.context->begin_transaction(group.level);
+					group.opened = std::chrono::steady_clock::now();
+				}
+
+				try {
+					result = handler.process(authenticated_id, *group.context);
+				}
+				catch (...) {
+					this->flush_group(false);
+					throw;
+				}
+
+				if (++group.pending >= group.max_size)
+					this->flush_group(true);
+
+				auto deadline = group.opened + group.max_delay;
+				while (!batch->done)
+					if (group.committed.wait_until(lck, deadline) == std::cv_status::timeout && !batch->done)
+						this->flush_group(true);
+
+				if (batch->failed)
+					throw util::sql::synchronization_exception();
+
+				return result;
+			}
 
 		public:
-			processor_node_db(context_creator ctx_creator, word workers, std::vector<util::net::endpoint> eps, util::net::endpoint broker_ep = util::net::endpoint(), obj_id area_id = 0) : processor_node(workers, eps, broker_ep, area_id) {
-				for (word i = 0; i < this->workers; i++)
-					this->dbs.emplace_back(std::move(ctx_creator(i)));
+			processor_node_db(context_creator ctx_creator, word workers, std::vector<util::net::endpoint> eps, util::net::endpoint broker_ep = util::net::endpoint(), obj_id area_id = 0) : processor_node(workers, eps, broker_ep, area_id), creator(ctx_creator), deferred_contexts_created(0), deferred_context_limit(workers) {
+				this->dbs.resize(this->workers);
+			}
+
+			processor_node_db(context_creator ctx_creator, word workers, std::vector<util::net::endpoint> eps, std::vector<util::net::endpoint> broker_eps, obj_id area_id) : processor_node(workers, eps, broker_eps, area_id), creator(ctx_creator), deferred_contexts_created(0), deferred_context_limit(workers) {
+				this->dbs.resize(this->workers);
 			}
 
 			virtual ~processor_node_db() = default;
 
+			virtual void start() override {
+				for (word i = 0; i < this->workers && this->worker_cpus.empty(); i++)
+					this->dbs[i] = this->creator(i);
+
+				processor_node::start();
+			}
+
+			T& get_context(word worker_num) {
+				return *this->dbs[worker_num].get();
+			}
+
+			void set_context_reset_handler(context_reset_handler handler) {
+				this->on_context_reset = handler;
+			}
+
+			void reset_context(word worker_num) {
+				this->dbs[worker_num] = this->creator(worker_num);
+
+				if (this->on_context_reset)
+					this->on_context_reset(worker_num, *this->dbs[worker_num]);
+			}
+
+			template<typename U> void register_handler(uint8 category, uint8 method, bool authenticated, transaction_mode mode = transaction_mode::read_write, util::sql::connection::isolation_level level = util::sql::connection::isolation_level::repeatable_read) {
+				static_assert(std::is_base_of<base_handler, U>::value, "typename U must derive from processor_node_db::base_handler.");
+
+				processor_node::register_handler<U>(category, method, authenticated);
+
+				this->transaction_modes[(category << 8) | method] = transaction_options { mode, level };
+			}
+
+			template<typename U> void register_deferred_handler(uint8 category, uint8 method, bool authenticated) {
+				static_assert(std::is_base_of<deferred_handler, U>::value, "typename U must derive from processor_node_db::deferred_handler.");
+
+				(authenticated ? this->authenticated_deferred_handlers : this->unauthenticated_deferred_handlers)[(category << 8) | method] = [] { return std::shared_ptr<deferred_handler>(new U()); };
+
+				this->add_stats((category << 8) | method);
+			}
+
+			void set_deferred_context_limit(word limit) {
+				std::unique_lock<std::mutex> lck(this->deferred_contexts_lock);
+
+				this->deferred_context_limit = limit;
+			}
+
+			void enable_group_commit(word max_size, std::chrono::microseconds max_delay, util::sql::connection::isolation_level level = util::sql::connection::isolation_level::repeatable_read) {
+				this->group.reset(new group_commit());
+				this->group->context = this->creator(this->workers);
+				this->group->current = std::make_shared<group_batch>(group_batch { false, false });
+				this->group->level = level;
+				this->group->max_delay = max_delay;
+				this->group->max_size = max_size;
+				this->group->pending = 0;
+			}
+
+			virtual void place_worker(word worker_num) override {
+				processor_node::place_worker(worker_num);
+
+				this->dbs[worker_num] = this->creator(worker_num);
+			}
+
 			virtual util::net::request_server::request_result on_request(std::shared_ptr<util::net::tcp_connection> client, word worker_num, uint8 category, uint8 method, util::data_stream& parameters, util::data_stream& response) override {
+				this->pin_worker(worker_num);
+
 				result_code result = result_codes::success;
-				obj_id authenticated_id = reinterpret_cast<obj_id>(client->state);
-				obj_id start_id = authenticated_id;
 				uint16 type = (category << 8) | method;
 				T& context = *this->dbs[worker_num].get();
+				uint32 tag = 0;
+
+				if (this->dispatch_broker_batch(client, worker_num, category, method, parameters) || this->dispatch_control(client.get(), category, method, parameters))
+					return util::net::request_server::request_result::no_response;
+
+				if (!this->read_request_tag(client.get(), parameters, response, tag))
+					return util::net::request_server::request_result::success;
+
+				processor_node::admission_ticket ticket(*this, client, type);
+				if (!ticket)
+					return util::net::request_server::request_result::retry_later;
+
+				auto session = this->lock_session(client, type);
+				obj_id authenticated_id = this->get_client_id(client.get());
+				obj_id start_id = authenticated_id;
+
+				if (this->serve_stats(authenticated_id, category, response))
+					return util::net::request_server::request_result::success;
+
+				auto& deferred_handlers = authenticated_id != 0 ? this->authenticated_deferred_handlers : this->unauthenticated_deferred_handlers;
+				auto deferred_iter = deferred_handlers.find(type);
+				if (deferred_iter != deferred_handlers.end())
+					return this->process_deferred(client, deferred_iter->second(), authenticated_id, worker_num, parameters, response, this->get_stats(type, worker_num), ticket);
 
 				if ((authenticated_id != 0 && this->authenticated_handlers.count(type) == 0) || (authenticated_id == 0 && this->unauthenticated_handlers.count(type) == 0)) {
 					response.write(result_codes::invalid_request_type);
@@ -112,36 +594,74 @@ namespace game_server {
 				}
 
 				auto& handler = *reinterpret_cast<base_handler*>(authenticated_id != 0 ? this->authenticated_handlers[type][worker_num].get() : this->unauthenticated_handlers[type][worker_num].get());
+				auto iter = this->transaction_modes.find(type);
+				auto options = iter != this->transaction_modes.end() ? iter->second : transaction_options { transaction_mode::read_write, util::sql::connection::isolation_level::repeatable_read };
+				auto parameters_start = parameters.position();
+				auto& stats = this->get_stats(type, worker_num);
+				auto mark = std::chrono::steady_clock::now();
 
-				try {
-					handler.deserialize(parameters);
-				}
-				catch (util::data_stream::read_past_end_exception&) {
-					response.write(result_codes::invalid_parameters);
-					return util::net::request_server::request_result::success;
-				}
+				if (options.mode == transaction_mode::group && (!this->group || options.level != this->group->level))
+					options.mode = transaction_mode::read_write;
 
-				context.begin_transaction(util::sql::connection::isolation_level::repeatable_read);
-				try {
-					result = handler.process(authenticated_id, context);
-				}
-				catch (const util::sql::synchronization_exception&) {
-					return util::net::request_server::request_result::retry_later;
-				}
-				if (!context.committed()) {
+				for (word attempt = 0; ; attempt++) {
 					try {
-						context.commit_transaction();
+						handler.deserialize(parameters);
+					}
+					catch (util::data_stream::read_past_end_exception&) {
+						stats.record_result(result_codes::invalid_parameters);
+						response.write(result_codes::invalid_parameters);
+						return util::net::request_server::request_result::success;
+					}
+
+					mark = stats.record(handler_stats::stage::deserialize, mark);
+
+					if (options.mode == transaction_mode::read_only)
+						processor_node_db::begin_read_only(context, options.level, 0);
+					else if (options.mode == transaction_mode::read_write)
+						context.begin_transaction(options.level);
+
+					try {
+						if (options.mode == transaction_mode::group)
+							result = this->process_grouped(handler, authenticated_id);
+						else
+							result = handler.process(authenticated_id, context);
+
+						mark = stats.record(handler_stats::stage::process, mark);
+
+						if (options.mode == transaction_mode::read_only) {
+							if (!context.committed())
+								context.rollback_transaction();
+						}
+						else if (options.mode == transaction_mode::read_write && !context.committed()) {
+							context.commit_transaction();
+						}
+
+						mark = stats.record(handler_stats::stage::commit, mark);
+
+						break;
 					}
 					catch (const util::sql::synchronization_exception&) {
-						context.rollback_transaction();
-						return util::net::request_server::request_result::retry_later;
+						if ((options.mode == transaction_mode::read_only || options.mode == transaction_mode::read_write) && !context.committed())
+							context.rollback_transaction();
+
+						if (!this->wait_for_retry(worker_num, attempt)) {
+							stats.record_result(result_codes::retry_later);
+							return util::net::request_server::request_result::retry_later;
+						}
+
+						authenticated_id = start_id;
+						parameters.seek(parameters_start);
+						mark = std::chrono::steady_clock::now();
 					}
 				}
 
 				response.write(result);
+				stats.record_result(result);
 
-				if (result == result_codes::success)
+				if (result == result_codes::success) {
 					handler.serialize(response);
+					stats.record(handler_stats::stage::serialize, mark);
+				}
 				else if (result == result_codes::no_response)
 					return util::net::request_server::request_result::no_response;
 
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <string>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+#include <ArkeIndustries.CPPUtilities/DataStream.h>
+
+#include "Common.h"
+#include "MessageSchema.h"
+
+using namespace std;
+using namespace util;
+using namespace game_server;
+using namespace game_server::schema;
+
+struct sample {
+	buffer_view payload;
+	uint64 value;
+	array_view<uint32> items;
+
+	typedef codec<sample, bytes<sample, &sample::payload>, schema::value<sample, uint64, &sample::value>> request;
+	typedef codec<sample, list<sample, uint32, &sample::items>, schema::value<sample, uint64, &sample::value>> list_request;
+};
+
+static word failures = 0;
+
+static void check(const string& name, bool passed) {
+	if (!passed) {
+		cerr << "FAILED: " << name << endl;
+		failures++;
+	}
+}
+
+template<typename Codec> static bool rejects(data_stream& stream) {
+	sample target;
+
+	try {
+		Codec::read(target, stream);
+		return false;
+	}
+	catch (data_stream::read_past_end_exception&) {
+		return true;
+	}
+}
+
+int main() {
+	{
+		data_stream stream;
+		stream.write(static_cast<uint8>(0));
+		stream.seek(0);
+
+		check("short body", rejects<sample::request>(stream));
+	}
+
+	{
+		data_stream stream;
+		stream.write(static_cast<uint16>(8));
+		stream.write(static_cast<uint64>(0));
+		stream.seek(0);
+
+		check("variable field consumes fixed field", rejects<sample::request>(stream));
+	}
+
+	{
+		data_stream stream;
+		stream.write(static_cast<uint16>(64));
+		stream.write(static_cast<uint64>(0));
+		stream.seek(0);
+
+		check("over-long variable field", rejects<sample::request>(stream));
+	}
+
+	{
+		data_stream stream;
+		stream.write(static_cast<uint16>(2));
+		stream.write(static_cast<uint32>(1));
+		stream.write(static_cast<uint32>(2));
+		stream.seek(0);
+
+		check("list consumes fixed field", rejects<sample::list_request>(stream));
+	}
+
+	{
+		data_stream stream;
+		sample target;
+
+		stream.write(static_cast<uint16>(2));
+		stream.write(static_cast<uint8>('o'));
+		stream.write(static_cast<uint8>('k'));
+		stream.write(static_cast<uint64>(42));
+		stream.seek(0);
+
+		sample::request::read(target, stream);
+
+		check("well-formed body", target.payload.str() == "ok" && target.value == 42 && stream.position() == stream.size());
+	}
+
+	return failures == 0 ? 0 : 1;
+}
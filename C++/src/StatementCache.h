@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <chrono>
+
+#include <ArkeIndustries.CPPUtilities/Common.h>
+
+#include "Common.h"
+
+namespace game_server {
+	template<typename T> class statement_cache {
+		public:
+			typedef std::function<T(const std::string& name, const std::string& sql)> preparer;
+			typedef std::function<void(const std::string& name, T& statement)> releaser;
+
+		private:
+			preparer prepare;
+			releaser release;
+			std::unordered_map<std::string, T> statements;
+			word generation;
+			std::atomic<uint64> hits;
+			std::atomic<uint64> misses;
+			std::atomic<uint64> plan_time;
+
+		public:
+			statement_cache(const statement_cache& other) = delete;
+			statement_cache(statement_cache&& other) = delete;
+			statement_cache& operator=(statement_cache&& other) = delete;
+			statement_cache& operator=(const statement_cache& other) = delete;
+
+			statement_cache(preparer prepare, releaser release = releaser()) : prepare(prepare), release(release) {
+				this->generation = 0;
+				this->hits = 0;
+				this->misses = 0;
+				this->plan_time = 0;
+			}
+
+			~statement_cache() = default;
+
+			T& get(const std::string& name, const std::string& sql) {
+				auto iter = this->statements.find(name);
+				if (iter != this->statements.end()) {
+					this->hits++;
+					return iter->second;
+				}
+
+				this->misses++;
+
+				auto start = std::chrono::steady_clock::now();
+				auto& result = this->statements.emplace(name, this->prepare(this->generation == 0 ? name : name + "." + std::to_string(this->generation), sql)).first->second;
+				this->plan_time += static_cast<uint64>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+				return result;
+			}
+
+			void invalidate() {
+				if (this->release)
+					for (auto& i : this->statements)
+						this->release(this->generation == 0 ? i.first : i.first + "." + std::to_string(this->generation), i.second);
+				else
+					this->generation++;
+
+				this->statements.clear();
+			}
+
+			void reset() {
+				this->generation = 0;
+				this->statements.clear();
+			}
+
+			word size() const {
+				return this->statements.size();
+			}
+
+			uint64 get_hits() const {
+				return this->hits;
+			}
+
+			uint64 get_misses() const {
+				return this->misses;
+			}
+
+			std::chrono::microseconds get_plan_time() const {
+				return std::chrono::microseconds(this->plan_time);
+			}
+	};
+}
@@ -11,6 +11,9 @@ using namespace game_server::objects;
 updater::updater(word updates_per_tick, chrono::microseconds sleep_for) : timer(sleep_for) {
 	this->updates_per_tick = updates_per_tick;
 	this->position = 0;
+	this->cpu = 0;
+	this->pin_pending = false;
+	this->timer.on_tick += bind(&updater::place, this);
 	this->timer.on_tick += bind(&updater::tick, this);
 }
 
@@ -32,6 +35,16 @@ void updater::tick() {
 	}
 }
 
+void updater::set_cpu(word cpu) {
+	this->cpu = cpu;
+	this->pin_pending = true;
+}
+
+void updater::place() {
+	if (this->pin_pending.exchange(false) && placement::pin_current_thread(this->cpu))
+		placement::report("updater", 0, this->cpu);
+}
+
 void updater::add(updatable* object) {
 	unique_lock<mutex> lck(this->lock);
 	this->objects.push_back(object);
@@ -46,6 +59,9 @@ void updater::remove(updatable* object) {
 cache_updater::cache_updater(cache_provider& cache, word updates_per_tick, chrono::microseconds sleep_for) : cache(cache), timer(sleep_for) {
 	this->updates_per_tick = updates_per_tick;
 	this->position = 0;
+	this->cpu = 0;
+	this->pin_pending = false;
+	this->timer.on_tick += bind(&cache_updater::place, this);
 	this->timer.on_tick += bind(&cache_updater::tick, this);
 }
 
@@ -67,3 +83,13 @@ void cache_updater::tick() {
 		object->last_updated = now;
 	}
 }
+
+void cache_updater::set_cpu(word cpu) {
+	this->cpu = cpu;
+	this->pin_pending = true;
+}
+
+void cache_updater::place() {
+	if (this->pin_pending.exchange(false) && placement::pin_current_thread(this->cpu))
+		placement::report("cache_updater", 0, this->cpu);
+}
@@ -3,11 +3,13 @@
 #include <vector>
 #include <chrono>
 #include <thread>
+#include <atomic>
 
 #include <ArkeIndustries.CPPUtilities/Timer.h>
 
 #include "Objects.h"
 #include "CacheProvider.h"
+#include "Placement.h"
 
 namespace game_server {
 	class updater {
@@ -16,13 +18,18 @@ namespace game_server {
 		util::timer<> timer;
 		word position ;
 		word updates_per_tick;
+		word cpu;
+		std::atomic<bool> pin_pending;
 
 		void tick();
+		void place();
 
 		public:
 			updater(word updates_per_tick, std::chrono::microseconds sleep_for);
 			~updater();
 
+			void set_cpu(word cpu);
+
 			void add(objects::updatable* object);
 			void remove(objects::updatable* object);
 	};
@@ -32,11 +39,17 @@ namespace game_server {
 		util::timer<> timer;
 		word position;
 		word updates_per_tick;
+		word cpu;
+		std::atomic<bool> pin_pending;
 
-		void tick();
+		void place();
 
 		public:
 			cache_updater(cache_provider& cache, word updates_per_tick, std::chrono::microseconds sleep_for);
 			~cache_updater();
+
+			void set_cpu(word cpu);
+
+			void tick();
 	};
 }
\ No newline at end of file